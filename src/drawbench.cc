@@ -0,0 +1,342 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Offscreen rendering benchmark.
+ *
+ * Builds a terminal from a synthetic scenario or a recorded stream and
+ * repeatedly draws it into a cairo image surface, reporting frames per
+ * second and the time spent in the phases of draw_rows().  The terminal
+ * lives in a GtkOffscreenWindow, so no window is ever mapped; on machines
+ * without X or Wayland run it with the broadway backend, e.g.
+ *
+ *   broadwayd :5 & GDK_BACKEND=broadway BROADWAY_DISPLAY=:5 ./drawbench
+ *
+ * Parsing is not timed, only the drawing.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+#include "vteinternal.hh"
+#include "vtedraw.hh"
+
+typedef void (*ScenarioFunc)(GString *out, int columns, int rows, int frame);
+
+struct Scenario {
+        char const* name;
+        ScenarioFunc setup;   /* fills the screen once */
+        ScenarioFunc frame;   /* optional, run before every frame */
+};
+
+static void
+scenario_text_setup(GString *out,
+                    int columns,
+                    int rows,
+                    int frame)
+{
+        static char const words[] =
+                "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+                "eiusmod tempor incididunt ut labore et dolore magna aliqua. ";
+
+        for (int row = 0; row < rows; row++) {
+                if (row > 0)
+                        g_string_append(out, "\r\n");
+                for (int col = 0; col < columns; col++)
+                        g_string_append_c(out, words[(row * 7 + col) % (sizeof(words) - 1)]);
+        }
+}
+
+static void
+scenario_scroll_frame(GString *out,
+                      int columns,
+                      int rows,
+                      int frame)
+{
+        g_string_append_printf(out, "\r\n%6d ", frame);
+        for (int col = 7; col < columns; col++)
+                g_string_append_c(out, 'a' + (frame + col) % 26);
+}
+
+static void
+scenario_color_setup(GString *out,
+                     int columns,
+                     int rows,
+                     int frame)
+{
+        for (int row = 0; row < rows; row++) {
+                if (row > 0)
+                        g_string_append(out, "\r\n");
+                for (int col = 0; col < columns; col++) {
+                        int i = row * columns + col;
+
+                        switch (i / 4 % 4) {
+                        case 0: /* indexed, with bold or underline */
+                                g_string_append_printf(out, "\033[0;%d;38;5;%d;48;5;%dm",
+                                                       i % 3 ? 1 : 4, i % 256, (i * 7) % 256);
+                                break;
+                        case 1: /* legacy colors, some dim or reverse */
+                                g_string_append_printf(out, "\033[0;%d;%d;%dm",
+                                                       i % 5 ? 2 : 7, 30 + i % 8, 40 + (i / 8) % 8);
+                                break;
+                        default: /* direct color */
+                                g_string_append_printf(out, "\033[0;38;2;%d;%d;%d;48;2;%d;%d;%dm",
+                                                       i % 256, (i * 3) % 256, (i * 5) % 256,
+                                                       255 - i % 256, 128, (i * 11) % 256);
+                                break;
+                        }
+                        g_string_append_c(out, 'A' + i % 58);
+                }
+        }
+        g_string_append(out, "\033[0m");
+}
+
+static void
+scenario_cjk_setup(GString *out,
+                   int columns,
+                   int rows,
+                   int frame)
+{
+        for (int row = 0; row < rows; row++) {
+                if (row > 0)
+                        g_string_append(out, "\r\n");
+                for (int col = 0; col + 1 < columns; col += 2) {
+                        int i = row * columns + col;
+                        /* Mix ideographs with kana and fullwidth forms */
+                        gunichar c = i % 5 == 0 ? 0x3041 + i % 86
+                                   : i % 7 == 0 ? 0xff21 + i % 26
+                                   : 0x4e00 + (i * 31) % 0x5000;
+                        g_string_append_unichar(out, c);
+                }
+        }
+}
+
+static void
+scenario_box_setup(GString *out,
+                   int columns,
+                   int rows,
+                   int frame)
+{
+        /* A few nested frames with shaded interiors, like a TUI */
+        for (int row = 0; row < rows; row++) {
+                if (row > 0)
+                        g_string_append(out, "\r\n");
+                for (int col = 0; col < columns; col++) {
+                        int d = MIN(MIN(row, rows - 1 - row), MIN(col, columns - 1 - col) / 2);
+                        bool top = row == d, bottom = row == rows - 1 - d;
+                        bool left = col == 2 * d, right = col == columns - 1 - 2 * d;
+                        gunichar c;
+
+                        if (d >= 4)
+                                c = 0x2591 + (row + col) % 3;
+                        else if ((top || bottom) && (left || right))
+                                c = top ? (left ? 0x250c : 0x2510) : (left ? 0x2514 : 0x2518);
+                        else if (top || bottom)
+                                c = 0x2500;
+                        else if (left || right)
+                                c = 0x2502;
+                        else
+                                c = 0x2580 + (row * columns + col) % 0x20;
+                        g_string_append_unichar(out, c);
+                }
+        }
+}
+
+static Scenario const scenarios[] = {
+        { "text", scenario_text_setup, nullptr },
+        { "scroll", scenario_text_setup, scenario_scroll_frame },
+        { "color", scenario_color_setup, nullptr },
+        { "cjk", scenario_cjk_setup, nullptr },
+        { "box", scenario_box_setup, nullptr },
+};
+
+static void
+feed(VteTerminal *terminal,
+     GString *data)
+{
+        vte_terminal_feed(terminal, data->str, data->len);
+        g_string_truncate(data, 0);
+
+        /* Process right away instead of from the update timeout */
+        auto impl = _vte_terminal_get_impl(terminal);
+        while (impl->m_incoming_arena.buffered != 0)
+                impl->process_incoming();
+}
+
+static void
+run(VteTerminal *terminal,
+    char const* name,
+    Scenario const* scenario,
+    GString *recording,
+    int frames)
+{
+        auto impl = _vte_terminal_get_impl(terminal);
+        int columns = vte_terminal_get_column_count(terminal);
+        int rows = vte_terminal_get_row_count(terminal);
+        GString *data = g_string_new(nullptr);
+
+        vte_terminal_reset(terminal, TRUE, TRUE);
+        g_string_append(data, "\033[H\033[2J");
+        if (scenario != nullptr)
+                scenario->setup(data, columns, rows, 0);
+        else
+                g_string_append_len(data, recording->str, recording->len);
+        feed(terminal, data);
+
+        int width = gtk_widget_get_allocated_width(GTK_WIDGET(terminal));
+        int height = gtk_widget_get_allocated_height(GTK_WIDGET(terminal));
+        cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+
+        guint misses_before, misses_after;
+        gint64 lookup_before, lookup_after;
+        _vte_draw_get_glyph_lookup_stats(&misses_before, &lookup_before);
+        memset(&impl->m_draw_timings, 0, sizeof(impl->m_draw_timings));
+        impl->m_draw_timings_enabled = true;
+
+        gint64 elapsed = 0;
+        for (int frame = 0; frame < frames; frame++) {
+                if (scenario != nullptr && scenario->frame != nullptr) {
+                        scenario->frame(data, columns, rows, frame);
+                        feed(terminal, data);
+                }
+
+                cairo_t *cr = cairo_create(surface);
+                gint64 start = g_get_monotonic_time();
+                impl->widget_draw(cr);
+                cairo_surface_flush(surface);
+                elapsed += g_get_monotonic_time() - start;
+                cairo_destroy(cr);
+        }
+
+        impl->m_draw_timings_enabled = false;
+        _vte_draw_get_glyph_lookup_stats(&misses_after, &lookup_after);
+
+        auto const& t = impl->m_draw_timings;
+        double per_frame = 1000. * frames;
+        g_print("%-8s %6d %9.1f %8.3f %8.3f %8.3f %8.3f %8.3f %7u\n",
+                name, frames,
+                elapsed > 0 ? frames * 1000000. / elapsed : 0.,
+                t.runs / per_frame,
+                t.background / per_frame,
+                t.text / per_frame,
+                t.decorations / per_frame,
+                (lookup_after - lookup_before) / per_frame,
+                misses_after - misses_before);
+
+        cairo_surface_destroy(surface);
+        g_string_free(data, TRUE);
+}
+
+int
+main(int argc,
+     char *argv[])
+{
+        int columns = 80, rows = 24, frames = 500;
+        char *font = nullptr, *scenario_name = nullptr, *input = nullptr;
+        GOptionEntry const entries[] = {
+                { "columns", 'c', 0, G_OPTION_ARG_INT, &columns, "Number of columns", "COLUMNS" },
+                { "rows", 'r', 0, G_OPTION_ARG_INT, &rows, "Number of rows", "ROWS" },
+                { "font", 'f', 0, G_OPTION_ARG_STRING, &font, "Font description", "FONT" },
+                { "frames", 'n', 0, G_OPTION_ARG_INT, &frames, "Number of frames to draw per scenario", "N" },
+                { "scenario", 's', 0, G_OPTION_ARG_STRING, &scenario_name,
+                  "Scenario to run (text, scroll, color, cjk, box; default: all)", "NAME" },
+                { "input", 'i', 0, G_OPTION_ARG_FILENAME, &input,
+                  "Draw the screen left by a recorded stream instead", "FILE" },
+                { nullptr }
+        };
+        GError *error = nullptr;
+
+        if (!gtk_init_with_args(&argc, &argv, nullptr, entries, nullptr, &error)) {
+                /* Not a failure, just nothing to draw with */
+                g_printerr("Cannot initialise GTK+: %s\n"
+                           "Try running with GDK_BACKEND=broadway.\n",
+                           error ? error->message : "no display");
+                g_clear_error(&error);
+                return 77;
+        }
+
+        if (columns < 1 || rows < 1 || frames < 1) {
+                g_printerr("Invalid size or frame count\n");
+                return 1;
+        }
+
+        GString *recording = nullptr;
+        if (input != nullptr) {
+                char *contents;
+                gsize length;
+                if (!g_file_get_contents(input, &contents, &length, &error)) {
+                        g_printerr("Failed to read %s: %s\n", input, error->message);
+                        g_error_free(error);
+                        return 1;
+                }
+                recording = g_string_new_len(contents, length);
+                g_free(contents);
+        }
+
+        GtkWidget *window = gtk_offscreen_window_new();
+        GtkWidget *widget = vte_terminal_new();
+        VteTerminal *terminal = VTE_TERMINAL(widget);
+        gtk_container_add(GTK_CONTAINER(window), widget);
+
+        if (font != nullptr) {
+                PangoFontDescription *desc = pango_font_description_from_string(font);
+                vte_terminal_set_font(terminal, desc);
+                pango_font_description_free(desc);
+        }
+        vte_terminal_set_size(terminal, columns, rows);
+        vte_terminal_set_scrollback_lines(terminal, 10000);
+
+        gtk_widget_show_all(window);
+        while (gtk_events_pending())
+                gtk_main_iteration();
+
+        g_print("Drawing %ldx%ld cells of %ldx%ld pixels, times in ms per frame\n",
+                vte_terminal_get_column_count(terminal),
+                vte_terminal_get_row_count(terminal),
+                vte_terminal_get_char_width(terminal),
+                vte_terminal_get_char_height(terminal));
+        g_print("%-8s %6s %9s %8s %8s %8s %8s %8s %7s\n",
+                "scenario", "frames", "frames/s", "runs", "backgr", "text", "decor",
+                "glyphs", "misses");
+
+        if (recording != nullptr) {
+                run(terminal, "input", nullptr, recording, frames);
+                g_string_free(recording, TRUE);
+        } else {
+                bool found = false;
+                for (auto const& scenario : scenarios) {
+                        if (scenario_name != nullptr &&
+                            strcmp(scenario_name, scenario.name) != 0)
+                                continue;
+                        run(terminal, scenario.name, &scenario, nullptr, frames);
+                        found = true;
+                }
+                if (!found) {
+                        g_printerr("Unknown scenario %s\n", scenario_name);
+                        return 1;
+                }
+        }
+
+        gtk_widget_destroy(window);
+        g_free(font);
+        g_free(scenario_name);
+        g_free(input);
+
+        return 0;
+}
@@ -22,7 +22,6 @@
 #include <string.h>
 #include <glib-object.h>
 #include "debug.h"
-#include "caps.h"
 #include "matcher.h"
 #include "table.h"
 
@@ -36,80 +35,6 @@ static GMutex _vte_matcher_mutex;
 static struct _vte_matcher *_vte_matcher_singleton = NULL;
 static int _vte_matcher_ref_count = 0;
 
-static struct _vte_matcher_impl dummy_vte_matcher_table = {
-	&_vte_matcher_table
-};
-
-/* Add a string to the matcher. */
-static void
-_vte_matcher_add(const struct _vte_matcher *matcher,
-		 const char *pattern, gssize length,
-		 const char *result)
-{
-	matcher->impl->klass->add(matcher->impl, pattern, length, result);
-}
-
-/* Loads all sequences into matcher */
-static void
-_vte_matcher_init(struct _vte_matcher *matcher)
-{
-	const char *code, *value;
-        char *c1;
-        int i, k, n, variants;
-
-	_vte_debug_print(VTE_DEBUG_LIFECYCLE, "_vte_matcher_init()\n");
-
-        code = _vte_xterm_capability_strings;
-        do {
-                value = strchr(code, '\0') + 1;
-
-                /* Escape sequences from \e@ to \e_ have a C1 counterpart
-                 * with the eighth bit set instead of a preceding '\x1b'.
-                 * This is encoded in the current encoding, e.g. in UTF-8
-                 * the C1 CSI (U+009B) becomes \xC2\x9B.
-                 *
-                 * When matching, the bytestream is already decoded to
-                 * Unicode codepoints.  In the "code" string, each byte
-                 * is interpreted as a Unicode codepoint (in other words,
-                 * Latin-1 is assumed).  So '\x80' .. '\x9F' bytes
-                 * (e.g. the byte '\x9B' for CSI) are the right choice here.
-                 *
-                 * For each sequence containing N occurrences of \e@ to \e_,
-                 * we create 2^N variants, by replacing every subset of them
-                 * with their C1 counterpart.
-                 */
-                variants = 1;
-                for (i = 0; code[i] != '\0'; i++) {
-                        if (code[i] == '\x1B' && code[i + 1] >= '@' && code[i + 1] <= '_') {
-                                variants <<= 1;
-                        }
-                }
-                for (n = 0; n < variants; n++) {
-                        c1 = g_strdup(code);
-                        k = 0;
-                        for (i = 0; c1[i] != '\0'; i++) {
-                                if (c1[i] == '\x1B' && c1[i + 1] >= '@' && c1[i + 1] <= '_') {
-                                        if (n & (1 << k)) {
-                                                memmove(c1 + i, c1 + i + 1, strlen(c1 + i + 1) + 1);
-                                                c1[i] += 0x40;
-                                        }
-                                        k++;
-                                }
-                        }
-                        _vte_matcher_add(matcher, c1, strlen(c1), value);
-                        g_free(c1);
-                }
-
-                code = strchr(value, '\0') + 1;
-        } while (*code);
-
-	_VTE_DEBUG_IF(VTE_DEBUG_MATCHER) {
-		g_printerr("Matcher contents:\n");
-		_vte_matcher_print(matcher);
-		g_printerr("\n");
-	}
-}
-
 /* Allocates new matcher structure. */
 static struct _vte_matcher *
 _vte_matcher_create(void)
@@ -118,10 +43,18 @@ _vte_matcher_create(void)
 
 	_vte_debug_print(VTE_DEBUG_LIFECYCLE, "_vte_matcher_create()\n");
 	ret = g_slice_new(struct _vte_matcher);
-        ret->impl = &dummy_vte_matcher_table;
-	ret->match = NULL;
+        /* The sequence tree is static data generated at build time, see
+         * table-generate, so there is nothing to build here. */
+        ret->impl = _vte_table_get_static();
+	ret->match = ret->impl->klass->match;
 	ret->free_params = NULL;
 
+	_VTE_DEBUG_IF(VTE_DEBUG_MATCHER) {
+		g_printerr("Matcher contents:\n");
+		_vte_matcher_print(ret);
+		g_printerr("\n");
+	}
+
 	return ret;
 }
 
@@ -133,8 +66,6 @@ _vte_matcher_destroy(struct _vte_matcher *matcher)
 	if (matcher->free_params != NULL) {
 		g_value_array_free (matcher->free_params);
 	}
-	if (matcher->match != NULL) /* do not call destroy on dummy values */
-		matcher->impl->klass->destroy(matcher->impl);
 	g_slice_free(struct _vte_matcher, matcher);
 }
 
@@ -149,12 +80,6 @@ _vte_matcher_new(void)
         if (_vte_matcher_ref_count++ == 0) {
                 g_assert(_vte_matcher_singleton == NULL);
                 ret = _vte_matcher_create();
-
-                if (ret->match == NULL) {
-                        ret->impl = ret->impl->klass->create();
-                        ret->match = ret->impl->klass->match;
-                        _vte_matcher_init(ret);
-                }
                 _vte_matcher_singleton = ret;
 	}
 
@@ -218,3 +143,49 @@ _vte_matcher_free_params_array(struct _vte_matcher *matcher,
 		params->n_values = 0;
 	}
 }
+
+/* Whether the partial sequence is already inside the free-form payload of an
+ * OSC, DCS or SOS, so that more data can only complete it with a BEL, a C1 ST
+ * or an ESC (starting ST) and nothing else needs rematching.  The introducer
+ * may be the 7-bit ESC form or its C1 counterpart, the table holds both. */
+gboolean
+_vte_matcher_is_partial_string(const gunichar *pattern, gssize length)
+{
+	gunichar introducer;
+	gssize i;
+
+	if (length < 1)
+		return FALSE;
+
+	if (pattern[0] == 0x1b) {
+		if (length < 2)
+			return FALSE;
+		/* ESC @ to ESC _ are the 7-bit forms of U+0080 to U+009F */
+		if (pattern[1] < '@' || pattern[1] > '_')
+			return FALSE;
+		introducer = pattern[1] + 0x40;
+		i = 2;
+	} else {
+		introducer = pattern[0];
+		i = 1;
+	}
+
+	switch (introducer) {
+	case 0x90: /* DCS */
+	case 0x98: /* SOS */
+		return TRUE;
+	case 0x9d: /* OSC */
+		/* Skip the number, then wait for something that can't be
+		 * the argument of OSC 50;#n or OSC 104;n. */
+		for (; i < length && pattern[i] != ';'; i++)
+			;
+		for (; i < length; i++) {
+			if (!((pattern[i] >= '0' && pattern[i] <= '9') ||
+			      pattern[i] == ';' || pattern[i] == ':' || pattern[i] == '#'))
+				return TRUE;
+		}
+		return FALSE;
+	default:
+		return FALSE;
+	}
+}
@@ -69,6 +69,9 @@ void _vte_matcher_print(struct _vte_matcher *matcher);
 /* Free a parameter array. */
 void _vte_matcher_free_params_array(struct _vte_matcher *matcher, GValueArray *params);
 
+/* Check if a partial sequence has reached the payload of a string sequence. */
+gboolean _vte_matcher_is_partial_string(const gunichar *pattern, gssize length);
+
 G_END_DECLS
 
 #endif
@@ -52,6 +52,250 @@ _vte_ring_validate (VteRing * ring)
 #endif
 
 
+/*
+ * VteRowRecordStream: The varint encoded index of the frozen rows
+ */
+
+/* Longest possible encoding of a block: two varints of at most 10 bytes per row */
+#define VTE_ROW_RECORD_BLOCK_BYTES_MAX (VTE_ROW_RECORD_BLOCK_SIZE * 2 * 10)
+
+/* Write out the pending records once this many bytes are collected */
+#define VTE_ROW_RECORD_PENDING_MAX 0x10000
+
+static inline char *
+_vte_varint_put (char *p, guint64 v)
+{
+        while (v >= 0x80) {
+                *p++ = (char) (v | 0x80);
+                v >>= 7;
+        }
+        *p++ = (char) v;
+        return p;
+}
+
+static inline const char *
+_vte_varint_get (const char *p, const char *end, guint64 *v)
+{
+        guint64 result = 0;
+        int shift;
+
+        for (shift = 0; p < end && shift < 64; shift += 7) {
+                guchar c = *p++;
+                result |= (guint64) (c & 0x7F) << shift;
+                if (!(c & 0x80)) {
+                        *v = result;
+                        return p;
+                }
+        }
+        return NULL;
+}
+
+static void
+_vte_row_records_init (VteRowRecordStream *rs)
+{
+        rs->records = _vte_file_stream_new ();
+        rs->blocks = _vte_file_stream_new ();
+        rs->blocks_origin = 0;
+        rs->first = rs->end = 0;
+        rs->last_text_offset = rs->last_attr_offset = 0;
+        rs->pending = g_string_new (NULL);
+        rs->pending_blocks = g_string_new (NULL);
+        rs->cached_block = (gulong) -1;
+}
+
+static void
+_vte_row_records_fini (VteRowRecordStream *rs)
+{
+        g_object_unref (rs->records);
+        g_object_unref (rs->blocks);
+        g_string_free (rs->pending, TRUE);
+        g_string_free (rs->pending_blocks, TRUE);
+}
+
+static inline gsize
+_vte_row_records_block_offset (VteRowRecordStream *rs, gulong block)
+{
+        return rs->blocks_origin + (block - rs->first / VTE_ROW_RECORD_BLOCK_SIZE) * sizeof (gsize);
+}
+
+static void
+_vte_row_records_flush (VteRowRecordStream *rs)
+{
+        if (rs->pending->len != 0)
+                _vte_stream_append (rs->records, rs->pending->str, rs->pending->len);
+        if (rs->pending_blocks->len != 0)
+                _vte_stream_append (rs->blocks, rs->pending_blocks->str, rs->pending_blocks->len);
+        g_string_truncate (rs->pending, 0);
+        g_string_truncate (rs->pending_blocks, 0);
+}
+
+/* Starts afresh, the next row to be appended is position. */
+static void
+_vte_row_records_reset (VteRowRecordStream *rs, gulong position)
+{
+        g_string_truncate (rs->pending, 0);
+        g_string_truncate (rs->pending_blocks, 0);
+        _vte_stream_reset (rs->records, _vte_stream_head (rs->records));
+        _vte_stream_reset (rs->blocks, _vte_stream_head (rs->blocks));
+        rs->blocks_origin = _vte_stream_head (rs->blocks);
+        rs->first = rs->end = position;
+        rs->cached_block = (gulong) -1;
+}
+
+/* Appends the record of the row at position, which has to be rs->end.
+ * The data is kept in memory until _vte_row_records_flush(). */
+static void
+_vte_row_records_append (VteRowRecordStream *rs, const VteRowRecord *record, gulong position)
+{
+        char buf[2 * 10], *p = buf;
+        guint flags = (record->soft_wrapped ? 2 : 0) | (record->is_ascii ? 1 : 0);
+
+        g_assert_cmpuint (position, ==, rs->end);
+
+        if (position == rs->first || position % VTE_ROW_RECORD_BLOCK_SIZE == 0) {
+                gsize offset = _vte_stream_head (rs->records) + rs->pending->len;
+                g_string_append_len (rs->pending_blocks, (const char *) &offset, sizeof (offset));
+                p = _vte_varint_put (p, ((guint64) record->text_start_offset << 2) | flags);
+                p = _vte_varint_put (p, record->attr_start_offset);
+        } else {
+                p = _vte_varint_put (p, ((guint64) (record->text_start_offset - rs->last_text_offset) << 2) | flags);
+                p = _vte_varint_put (p, record->attr_start_offset - rs->last_attr_offset);
+        }
+        g_string_append_len (rs->pending, buf, p - buf);
+
+        rs->last_text_offset = record->text_start_offset;
+        rs->last_attr_offset = record->attr_start_offset;
+        if (position / VTE_ROW_RECORD_BLOCK_SIZE == rs->cached_block)
+                rs->cached_block = (gulong) -1;
+        rs->end++;
+
+        if (rs->pending->len >= VTE_ROW_RECORD_PENDING_MAX)
+                _vte_row_records_flush (rs);
+}
+
+/* Decodes the records of the rows first_row..end_row-1 of a block, read
+ * from offset into buf, into cache and cache_offsets. */
+static gboolean
+_vte_row_records_decode (const char *buf, gsize len, gsize offset, gulong first_row, gulong end_row,
+                         VteRowRecord *cache, gsize *cache_offsets)
+{
+        const char *p = buf, *end = buf + len;
+        gsize text_offset = 0, attr_offset = 0;
+        gulong row;
+        guint64 v, a;
+
+        for (row = first_row; row < end_row; row++) {
+                VteRowRecord *record = &cache[row % VTE_ROW_RECORD_BLOCK_SIZE];
+
+                cache_offsets[row % VTE_ROW_RECORD_BLOCK_SIZE] = offset + (p - buf);
+                if ((p = _vte_varint_get (p, end, &v)) == NULL ||
+                    (p = _vte_varint_get (p, end, &a)) == NULL)
+                        return FALSE;
+
+                text_offset = (row == first_row ? 0 : text_offset) + (v >> 2);
+                attr_offset = (row == first_row ? 0 : attr_offset) + a;
+                memset (record, 0, sizeof (*record));
+                record->text_start_offset = text_offset;
+                record->attr_start_offset = attr_offset;
+                record->soft_wrapped = (v & 2) != 0;
+                record->is_ascii = (v & 1) != 0;
+        }
+        return TRUE;
+}
+
+/* Decodes all the rows present in the given block into the cache. */
+static gboolean
+_vte_row_records_load_block (VteRowRecordStream *rs, gulong block)
+{
+        char buf[VTE_ROW_RECORD_BLOCK_BYTES_MAX];
+        gulong first_row, end_row;
+        gsize offset, len;
+
+        if (rs->cached_block == block)
+                return TRUE;
+
+        g_assert (rs->pending->len == 0);
+        rs->cached_block = (gulong) -1;
+
+        first_row = MAX (block * VTE_ROW_RECORD_BLOCK_SIZE, rs->first);
+        end_row = MIN ((block + 1) * VTE_ROW_RECORD_BLOCK_SIZE, rs->end);
+        if (first_row >= end_row)
+                return FALSE;
+
+        if (!_vte_stream_read (rs->blocks, _vte_row_records_block_offset (rs, block), (char *) &offset, sizeof (offset)))
+                return FALSE;
+        len = MIN (sizeof (buf), _vte_stream_head (rs->records) - offset);
+        if (!_vte_stream_read (rs->records, offset, buf, len))
+                return FALSE;
+        if (!_vte_row_records_decode (buf, len, offset, first_row, end_row, rs->cache, rs->cache_offsets))
+                return FALSE;
+
+        rs->cached_block = block;
+        return TRUE;
+}
+
+static gboolean
+_vte_row_records_read (VteRowRecordStream *rs, VteRowRecord *record, gulong position)
+{
+        if (position < rs->first || position >= rs->end)
+                return FALSE;
+        if (!_vte_row_records_load_block (rs, position / VTE_ROW_RECORD_BLOCK_SIZE))
+                return FALSE;
+
+        *record = rs->cache[position % VTE_ROW_RECORD_BLOCK_SIZE];
+        return TRUE;
+}
+
+/* Drops the records of position and the rows after it. */
+static void
+_vte_row_records_truncate (VteRowRecordStream *rs, gulong position)
+{
+        gulong block;
+        gsize offset;
+
+        g_assert (rs->pending->len == 0);
+
+        if (position >= rs->end)
+                return;
+        position = MAX (position, rs->first);
+        block = position / VTE_ROW_RECORD_BLOCK_SIZE;
+
+        if (position <= MAX (block * VTE_ROW_RECORD_BLOCK_SIZE, rs->first)) {
+                /* Drop whole blocks */
+                if (!_vte_stream_read (rs->blocks, _vte_row_records_block_offset (rs, block), (char *) &offset, sizeof (offset)))
+                        return;
+                _vte_stream_truncate (rs->blocks, _vte_row_records_block_offset (rs, block));
+        } else {
+                if (!_vte_row_records_load_block (rs, block))
+                        return;
+                offset = rs->cache_offsets[position % VTE_ROW_RECORD_BLOCK_SIZE];
+                rs->last_text_offset = rs->cache[(position - 1) % VTE_ROW_RECORD_BLOCK_SIZE].text_start_offset;
+                rs->last_attr_offset = rs->cache[(position - 1) % VTE_ROW_RECORD_BLOCK_SIZE].attr_start_offset;
+                _vte_stream_truncate (rs->blocks, _vte_row_records_block_offset (rs, block + 1));
+        }
+        _vte_stream_truncate (rs->records, offset);
+
+        rs->end = position;
+        rs->cached_block = (gulong) -1;
+}
+
+/* Releases the records of the rows before position, as far as possible. */
+static void
+_vte_row_records_advance_tail (VteRowRecordStream *rs, gulong position)
+{
+        gulong block = position / VTE_ROW_RECORD_BLOCK_SIZE;
+        gsize offset;
+
+        if (position < rs->first || position >= rs->end)
+                return;
+
+        if (!_vte_stream_read (rs->blocks, _vte_row_records_block_offset (rs, block), (char *) &offset, sizeof (offset)))
+                return;
+        _vte_stream_advance_tail (rs->blocks, _vte_row_records_block_offset (rs, block));
+        _vte_stream_advance_tail (rs->records, offset);
+}
+
+
 void
 _vte_ring_init (VteRing *ring, gulong max_rows, gboolean has_streams)
 {
@@ -70,19 +314,22 @@ _vte_ring_init (VteRing *ring, gulong max_rows, gboolean has_streams)
 	if (has_streams) {
 		ring->attr_stream = _vte_file_stream_new ();
 		ring->text_stream = _vte_file_stream_new ();
-		ring->row_stream = _vte_file_stream_new ();
+		_vte_row_records_init (&ring->row_records);
 	} else {
-		ring->attr_stream = ring->text_stream = ring->row_stream = NULL;
+		ring->attr_stream = ring->text_stream = NULL;
 	}
 
 	ring->last_attr_text_start_offset = 0;
 	ring->last_attr = basic_cell.attr;
 	ring->utf8_buffer = g_string_sized_new (128);
+        ring->freeze_text_buffer = g_string_sized_new (128);
+        ring->freeze_attr_buffer = g_string_new (NULL);
 
 	_vte_row_data_init (&ring->cached_row);
 	ring->cached_row_num = (gulong) -1;
 
         ring->visible_rows = 0;
+        ring->stream_reads = 0;
 
         ring->hyperlinks = g_ptr_array_new();
         empty_str = g_string_new_len("", 0);
@@ -108,10 +355,12 @@ _vte_ring_fini (VteRing *ring)
 	if (ring->has_streams) {
 		g_object_unref (ring->attr_stream);
 		g_object_unref (ring->text_stream);
-		g_object_unref (ring->row_stream);
+		_vte_row_records_fini (&ring->row_records);
 	}
 
 	g_string_free (ring->utf8_buffer, TRUE);
+        g_string_free (ring->freeze_text_buffer, TRUE);
+        g_string_free (ring->freeze_attr_buffer, TRUE);
 
         for (i = 0; i < ring->hyperlinks->len; i++)
                 g_string_free (hyperlink_get(ring, i), TRUE);
@@ -120,13 +369,6 @@ _vte_ring_fini (VteRing *ring)
 	_vte_row_data_fini (&ring->cached_row);
 }
 
-typedef struct _VteRowRecord {
-	gsize text_start_offset;  /* offset where text of this row begins */
-	gsize attr_start_offset;  /* offset of the first character's attributes */
-	int soft_wrapped: 1;      /* end of line is not '\n' */
-	int is_ascii: 1;          /* for rewrapping speedup: guarantees that line contains 32..126 bytes only. Can be 0 even when ascii only. */
-} VteRowRecord;
-
 /* Represents a cell position, see ../doc/rewrap.txt */
 typedef struct _VteCellTextOffset {
 	gsize text_offset;    /* byte offset in text_stream (or perhaps beyond) */
@@ -151,9 +393,10 @@ _vte_ring_writable_index (VteRing *ring, gulong position)
 static void
 _vte_ring_hyperlink_gc (VteRing *ring)
 {
-        gulong i, j;
+        gulong i, j, n_spans;
         hyperlink_idx_t idx;
         VteRowData *row;
+        const VteHyperlinkSpan *spans;
         char *used;
 
         _vte_debug_print (VTE_DEBUG_HYPERLINK,
@@ -178,9 +421,9 @@ _vte_ring_hyperlink_gc (VteRing *ring)
 
         for (i = ring->writable; i < ring->end; i++) {
                 row = _vte_ring_writable_index (ring, i);
-                for (j = 0; j < row->len; j++) {
-                        idx = row->cells[j].attr.hyperlink_idx;
-                        SET_BIT(used, idx);
+                spans = _vte_row_data_get_hyperlinks (row, &n_spans);
+                for (j = 0; j < n_spans; j++) {
+                        SET_BIT(used, spans[j].idx);
                 }
         }
 
@@ -317,35 +560,35 @@ _vte_ring_get_hyperlink_idx (VteRing *ring, const char *hyperlink)
 static gboolean
 _vte_ring_read_row_record (VteRing *ring, VteRowRecord *record, gulong position)
 {
-	return _vte_stream_read (ring->row_stream, position * sizeof (*record), (char *) record, sizeof (*record));
+        ring->stream_reads++;
+	return _vte_row_records_read (&ring->row_records, record, position);
 }
 
-static void
-_vte_ring_append_row_record (VteRing *ring, const VteRowRecord *record, gulong position)
-{
-	_vte_stream_append (ring->row_stream, (const char *) record, sizeof (*record));
-}
-
-static void
+/* Appends the row to the freeze buffers, see _vte_ring_freeze_rows().
+ * Returns whether any hyperlink was frozen. */
+static gboolean
 _vte_ring_freeze_row (VteRing *ring, gulong position, const VteRowData *row)
 {
 	VteRowRecord record;
 	VteCell *cell;
-	GString *buffer = ring->utf8_buffer;
+	GString *buffer = ring->freeze_text_buffer;
+	GString *attrs = ring->freeze_attr_buffer;
         GString *hyperlink;
 	int i;
+        gsize row_start;
         gboolean froze_hyperlink = FALSE;
 
 	_vte_debug_print (VTE_DEBUG_RING, "Freezing row %lu.\n", position);
 
         g_assert(ring->has_streams);
 
+	/* The stream offsets include what's still pending in the buffers */
+	row_start = buffer->len;
 	memset(&record, 0, sizeof (record));
-	record.text_start_offset = _vte_stream_head (ring->text_stream);
-	record.attr_start_offset = _vte_stream_head (ring->attr_stream);
+	record.text_start_offset = _vte_stream_head (ring->text_stream) + buffer->len;
+	record.attr_start_offset = _vte_stream_head (ring->attr_stream) + attrs->len;
 	record.is_ascii = 1;
 
-	g_string_set_size (buffer, 0);
 	for (i = 0, cell = row->cells; i < row->len; i++, cell++) {
 		VteCellAttr attr;
 		int num_chars;
@@ -367,20 +610,20 @@ _vte_ring_freeze_row (VteRing *ring, gulong position, const VteRowData *row)
                         guint16 hyperlink_length;
 
 			if (memcmp(&ring->last_attr, &attr, sizeof (VteCellAttr)) != 0) {
-				ring->last_attr_text_start_offset = record.text_start_offset + buffer->len;
+				ring->last_attr_text_start_offset = record.text_start_offset + buffer->len - row_start;
 				memset(&attr_change, 0, sizeof (attr_change));
 				attr_change.text_end_offset = ring->last_attr_text_start_offset;
                                 _attrcpy(&attr_change.attr, &ring->last_attr);
                                 hyperlink = hyperlink_get(ring, ring->last_attr.hyperlink_idx);
                                 attr_change.attr.hyperlink_length = hyperlink->len;
-				_vte_stream_append (ring->attr_stream, (const char *) &attr_change, sizeof (attr_change));
+				g_string_append_len (attrs, (const char *) &attr_change, sizeof (attr_change));
                                 if (G_UNLIKELY (hyperlink->len != 0)) {
-                                        _vte_stream_append (ring->attr_stream, hyperlink->str, hyperlink->len);
+                                        g_string_append_len (attrs, hyperlink->str, hyperlink->len);
                                         froze_hyperlink = TRUE;
                                 }
                                 hyperlink_length = attr_change.attr.hyperlink_length;
-                                _vte_stream_append (ring->attr_stream, (const char *) &hyperlink_length, 2);
-				if (!buffer->len)
+                                g_string_append_len (attrs, (const char *) &hyperlink_length, 2);
+				if (buffer->len == row_start)
 					/* This row doesn't use last_attr, adjust */
                                         record.attr_start_offset += sizeof (attr_change) + hyperlink_length + 2;
 				ring->last_attr = attr;
@@ -390,20 +633,20 @@ _vte_ring_freeze_row (VteRing *ring, gulong position, const VteRowData *row)
 			if (num_chars > 1) {
                                 /* Combining chars */
 				attr.columns = 0;
-				ring->last_attr_text_start_offset = record.text_start_offset + buffer->len
+				ring->last_attr_text_start_offset = record.text_start_offset + buffer->len - row_start
 								  + g_unichar_to_utf8 (_vte_unistr_get_base (cell->c), NULL);
 				memset(&attr_change, 0, sizeof (attr_change));
 				attr_change.text_end_offset = ring->last_attr_text_start_offset;
                                 _attrcpy(&attr_change.attr, &ring->last_attr);
                                 hyperlink = hyperlink_get(ring, ring->last_attr.hyperlink_idx);
                                 attr_change.attr.hyperlink_length = hyperlink->len;
-				_vte_stream_append (ring->attr_stream, (const char *) &attr_change, sizeof (attr_change));
+				g_string_append_len (attrs, (const char *) &attr_change, sizeof (attr_change));
                                 if (G_UNLIKELY (hyperlink->len != 0)) {
-                                        _vte_stream_append (ring->attr_stream, hyperlink->str, hyperlink->len);
+                                        g_string_append_len (attrs, hyperlink->str, hyperlink->len);
                                         froze_hyperlink = TRUE;
                                 }
                                 hyperlink_length = attr_change.attr.hyperlink_length;
-                                _vte_stream_append (ring->attr_stream, (const char *) &hyperlink_length, 2);
+                                g_string_append_len (attrs, (const char *) &hyperlink_length, 2);
 				ring->last_attr = attr;
 			}
 
@@ -415,12 +658,9 @@ _vte_ring_freeze_row (VteRing *ring, gulong position, const VteRowData *row)
 		g_string_append_c (buffer, '\n');
 	record.soft_wrapped = row->attr.soft_wrapped;
 
-	_vte_stream_append (ring->text_stream, buffer->str, buffer->len);
-	_vte_ring_append_row_record (ring, &record, position);
+	_vte_row_records_append (&ring->row_records, &record, position);
 
-        /* After freezing some hyperlinks, do a hyperlink GC. The constant is totally arbitrary, feel free to fine tune. */
-        if (froze_hyperlink)
-                _vte_ring_hyperlink_maybe_gc(ring, 1024);
+        return froze_hyperlink;
 }
 
 /* If do_truncate (data is placed back from the stream to the ring), real new hyperlink idxs are looked up or allocated.
@@ -457,7 +697,7 @@ _vte_ring_thaw_row (VteRing *ring, gulong position, VteRowData *row, gboolean do
 
 	if (!_vte_ring_read_row_record (ring, &records[0], position))
 		return;
-	if ((position + 1) * sizeof (records[0]) < _vte_stream_head (ring->row_stream)) {
+	if (position + 1 < ring->row_records.end) {
 		if (!_vte_ring_read_row_record (ring, &records[1], position + 1))
 			return;
 	} else
@@ -593,7 +833,7 @@ _vte_ring_thaw_row (VteRing *ring, gulong position, VteRowData *row, gboolean do
 				ring->last_attr = basic_cell.attr;
 			}
 		}
-		_vte_stream_truncate (ring->row_stream, position * sizeof (record));
+		_vte_row_records_truncate (&ring->row_records, position);
 		_vte_stream_truncate (ring->attr_stream, attr_stream_truncate_at);
 		_vte_stream_truncate (ring->text_stream, records[0].text_start_offset);
 	}
@@ -605,7 +845,7 @@ _vte_ring_reset_streams (VteRing *ring, gulong position)
 	_vte_debug_print (VTE_DEBUG_RING, "Reseting streams to %lu.\n", position);
 
 	if (ring->has_streams) {
-		_vte_stream_reset (ring->row_stream, position * sizeof (VteRowRecord));
+		_vte_row_records_reset (&ring->row_records, position);
                 _vte_stream_reset (ring->text_stream, _vte_stream_head (ring->text_stream));
                 _vte_stream_reset (ring->attr_stream, _vte_stream_head (ring->attr_stream));
 	}
@@ -686,8 +926,10 @@ _vte_ring_get_hyperlink_at_position (VteRing *ring, gulong position, int col, bo
                 idx = row->cells[col].attr.hyperlink_idx;
         } else {
                 _vte_ring_thaw_row (ring, position, &ring->cached_row, FALSE, col, hyperlink);
-                /* Note: Intentionally don't set cached_row_num. We're about to update
-                 * ring->hyperlink_hover_idx which makes some idxs no longer valid. */
+                /* Note: Intentionally don't set cached_row_num to position. We might be about
+                 * to update ring->hyperlink_hover_idx which makes some idxs no longer valid.
+                 * The cached row got overwritten in any case. */
+                ring->cached_row_num = (gulong) -1;
                 idx = _vte_ring_get_hyperlink_idx_no_update_current(ring, *hyperlink);
         }
         if (**hyperlink == '\0')
@@ -707,18 +949,43 @@ _vte_ring_index_writable (VteRing *ring, gulong position)
 	return _vte_ring_writable_index (ring, position);
 }
 
+/*
+ * Freezes the given number of rows at the top of the writable area.
+ *
+ * The rows' text, attribute changes and row records are collected in memory
+ * and each stream is appended to only once for the whole batch.
+ */
 static void
-_vte_ring_freeze_one_row (VteRing *ring)
+_vte_ring_freeze_rows (VteRing *ring, gulong count)
 {
 	VteRowData *row;
+        gulong froze_hyperlinks = 0;
+
+        if (count == 0)
+                return;
+
+        g_assert (ring->writable + count <= ring->end);
 
 	if (G_UNLIKELY (ring->writable == ring->start))
 		_vte_ring_reset_streams (ring, ring->writable);
 
-	row = _vte_ring_writable_index (ring, ring->writable);
-	_vte_ring_freeze_row (ring, ring->writable, row);
+        for (; count > 0; count--) {
+                row = _vte_ring_writable_index (ring, ring->writable);
+                if (_vte_ring_freeze_row (ring, ring->writable, row))
+                        froze_hyperlinks++;
+                ring->writable++;
+        }
+
+        _vte_stream_append (ring->text_stream, ring->freeze_text_buffer->str, ring->freeze_text_buffer->len);
+        if (ring->freeze_attr_buffer->len != 0)
+                _vte_stream_append (ring->attr_stream, ring->freeze_attr_buffer->str, ring->freeze_attr_buffer->len);
+        _vte_row_records_flush (&ring->row_records);
+        g_string_truncate (ring->freeze_text_buffer, 0);
+        g_string_truncate (ring->freeze_attr_buffer, 0);
 
-	ring->writable++;
+        /* After freezing some hyperlinks, do a hyperlink GC. The constant is totally arbitrary, feel free to fine tune. */
+        if (froze_hyperlinks)
+                _vte_ring_hyperlink_maybe_gc(ring, 1024 * froze_hyperlinks);
 }
 
 static void
@@ -748,8 +1015,8 @@ _vte_ring_discard_one_row (VteRing *ring)
 		_vte_ring_reset_streams (ring, ring->writable);
 	} else if (ring->start < ring->writable) {
 		VteRowRecord record;
-		_vte_stream_advance_tail (ring->row_stream, ring->start * sizeof (record));
 		if (G_LIKELY (_vte_ring_read_row_record (ring, &record, ring->start))) {
+			_vte_row_records_advance_tail (&ring->row_records, ring->start);
 			_vte_stream_advance_tail (ring->text_stream, record.text_start_offset);
 			_vte_stream_advance_tail (ring->attr_stream, record.attr_start_offset);
 		}
@@ -759,10 +1026,12 @@ _vte_ring_discard_one_row (VteRing *ring)
 }
 
 static void
-_vte_ring_maybe_freeze_one_row (VteRing *ring)
+_vte_ring_maybe_freeze_rows (VteRing *ring)
 {
-        if (G_LIKELY (ring->mask >= ring->visible_rows && ring->writable + ring->mask + 1 == ring->end))
-		_vte_ring_freeze_one_row (ring);
+        /* Freeze in batches; the writable area always has room for them
+         * on top of the visible rows, so this never freezes onscreen rows. */
+        if (G_LIKELY (ring->mask >= ring->visible_rows + VTE_RING_FREEZE_BATCH && ring->writable + ring->mask + 1 == ring->end))
+		_vte_ring_freeze_rows (ring, VTE_RING_FREEZE_BATCH);
 	else
 		_vte_ring_ensure_writable_room (ring);
 }
@@ -780,7 +1049,7 @@ _vte_ring_ensure_writable_room (VteRing *ring)
 	gulong new_mask, old_mask, i, end;
 	VteRowData *old_array, *new_array;;
 
-        if (G_LIKELY (ring->mask >= ring->visible_rows && ring->writable + ring->mask + 1 > ring->end))
+        if (G_LIKELY (ring->mask >= ring->visible_rows + VTE_RING_FREEZE_BATCH && ring->writable + ring->mask + 1 > ring->end))
 		return;
 
 	old_mask = ring->mask;
@@ -788,7 +1057,7 @@ _vte_ring_ensure_writable_room (VteRing *ring)
 
 	do {
 		ring->mask = (ring->mask << 1) + 1;
-        } while (ring->mask < ring->visible_rows || ring->writable + ring->mask + 1 <= ring->end);
+        } while (ring->mask < ring->visible_rows + VTE_RING_FREEZE_BATCH || ring->writable + ring->mask + 1 <= ring->end);
 
 	_vte_debug_print(VTE_DEBUG_RING, "Enlarging writable array from %lu to %lu\n", old_mask, ring->mask);
 
@@ -864,6 +1133,39 @@ _vte_ring_shrink (VteRing *ring, gulong max_len)
 	_vte_ring_validate(ring);
 }
 
+/**
+ * _vte_ring_trim:
+ * @ring: a #VteRing
+ *
+ * Releases the buffers of the streams backing the scrollback; they are
+ * allocated again the next time the scrollback is accessed.
+ */
+void
+_vte_ring_trim (VteRing *ring)
+{
+	if (!ring->has_streams)
+		return;
+
+	_vte_debug_print(VTE_DEBUG_RING, "Trimming the stream buffers.\n");
+
+	_vte_stream_trim (ring->text_stream);
+	_vte_stream_trim (ring->attr_stream);
+	_vte_stream_trim (ring->row_records.records);
+	_vte_stream_trim (ring->row_records.blocks);
+}
+
+gsize
+_vte_ring_get_buffer_size (VteRing *ring)
+{
+	if (!ring->has_streams)
+		return 0;
+
+	return _vte_stream_get_buffer_size (ring->text_stream) +
+	       _vte_stream_get_buffer_size (ring->attr_stream) +
+	       _vte_stream_get_buffer_size (ring->row_records.records) +
+	       _vte_stream_get_buffer_size (ring->row_records.blocks);
+}
+
 /**
  * _vte_ring_insert_internal:
  * @ring: a #VteRing
@@ -899,7 +1201,7 @@ _vte_ring_insert (VteRing *ring, gulong position)
 	_vte_row_data_clear (row);
 	ring->end++;
 
-	_vte_ring_maybe_freeze_one_row (ring);
+	_vte_ring_maybe_freeze_rows (ring);
 
 	_vte_ring_validate(ring);
 	return row;
@@ -938,6 +1240,74 @@ _vte_ring_remove (VteRing * ring, gulong position)
 }
 
 
+/* Reverses the order of the writable rows in [first, last). */
+static void
+_vte_ring_reverse_rows (VteRing *ring, gulong first, gulong last)
+{
+	VteRowData tmp;
+
+	while (first + 1 < last) {
+		last--;
+		tmp = *_vte_ring_writable_index (ring, first);
+		*_vte_ring_writable_index (ring, first) = *_vte_ring_writable_index (ring, last);
+		*_vte_ring_writable_index (ring, last) = tmp;
+		first++;
+	}
+}
+
+/**
+ * _vte_ring_rotate:
+ * @ring: a #VteRing
+ * @start: the first row of the range
+ * @end: the row after the last row of the range
+ * @count: the number of rows to rotate by
+ *
+ * Rotates the rows in [@start, @end) by @count in a single pass, moving them
+ * towards @end if @count is positive and towards @start if negative.  The
+ * rows wrapped around to the other side of the range are cleared, as if
+ * |@count| rows had been removed at one end and empty ones inserted at the
+ * other.  The whole range must already exist in @ring.
+ */
+void
+_vte_ring_rotate (VteRing *ring, gulong start, gulong end, glong count)
+{
+	gulong len, n, first, i;
+
+	_vte_debug_print(VTE_DEBUG_RING, "Rotating [%lu, %lu) by %ld.\n", start, end, count);
+	_vte_ring_validate(ring);
+
+	if (G_UNLIKELY (start >= end || count == 0))
+		return;
+
+	_vte_ring_ensure_writable (ring, start);
+
+	g_assert (start >= ring->writable && end <= ring->end);
+
+	len = end - start;
+	n = MIN ((gulong) ABS (count), len);
+
+	/* Rotate with three reversals; rotating by the whole range is a no-op */
+	if (n < len) {
+		if (count > 0) {
+			_vte_ring_reverse_rows (ring, start, end);
+			_vte_ring_reverse_rows (ring, start, start + n);
+			_vte_ring_reverse_rows (ring, start + n, end);
+		} else {
+			_vte_ring_reverse_rows (ring, start, start + n);
+			_vte_ring_reverse_rows (ring, start + n, end);
+			_vte_ring_reverse_rows (ring, start, end);
+		}
+	}
+
+	/* Clear the vacated rows, keeping their cell arrays around */
+	first = count > 0 ? start : end - n;
+	for (i = first; i < first + n; i++)
+		_vte_row_data_clear (_vte_ring_writable_index (ring, i));
+
+	_vte_ring_validate(ring);
+}
+
+
 /**
  * _vte_ring_append:
  * @ring: a #VteRing
@@ -1021,7 +1391,7 @@ _vte_frozen_row_column_to_text_offset (VteRing *ring,
 	g_assert(position < ring->writable);
 	if (!_vte_ring_read_row_record (ring, &records[0], position))
 		return FALSE;
-	if ((position + 1) * sizeof (records[0]) < _vte_stream_head (ring->row_stream)) {
+	if (position + 1 < ring->row_records.end) {
 		if (!_vte_ring_read_row_record (ring, &records[1], position + 1))
 			return FALSE;
 	} else
@@ -1097,7 +1467,7 @@ _vte_frozen_row_text_offset_to_column (VteRing *ring,
 	g_assert_cmpuint(position, <, ring->writable);
 	if (!_vte_ring_read_row_record (ring, &records[0], position))
 		return FALSE;
-	if ((position + 1) * sizeof (records[0]) < _vte_stream_head (ring->row_stream)) {
+	if (position + 1 < ring->row_records.end) {
 		if (!_vte_ring_read_row_record (ring, &records[1], position + 1))
 			return FALSE;
 	} else
@@ -1165,7 +1535,7 @@ _vte_ring_rewrap (VteRing *ring,
 	VteVisualPosition *new_markers;
 	VteRowRecord old_record;
 	VteCellAttrChange attr_change;
-	VteStream *new_row_stream;
+	VteRowRecordStream new_row_records;
 	gsize paragraph_start_text_offset;
 	gsize paragraph_end_text_offset;
 	gsize paragraph_len;  /* excluding trailing '\n' */
@@ -1176,12 +1546,11 @@ _vte_ring_rewrap (VteRing *ring,
 		return;
 	_vte_debug_print(VTE_DEBUG_RING, "Ring before rewrapping:\n");
 	_vte_ring_validate(ring);
-	new_row_stream = _vte_file_stream_new ();
+	_vte_row_records_init (&new_row_records);
 
 	/* Freeze everything, because rewrapping is really complicated and we don't want to
 	   duplicate the code for frozen and thawed rows. */
-	while (ring->writable < ring->end)
-		_vte_ring_freeze_one_row(ring);
+	_vte_ring_freeze_rows (ring, ring->end - ring->writable);
 
 	/* For markers given as (row,col) pairs find their offsets in the text stream.
 	   This code requires that the rows are already frozen. */
@@ -1289,7 +1658,7 @@ _vte_ring_rewrap (VteRing *ring,
 					if (col >= columns - attr_change.attr.columns + 1) {
 						/* Wrap now, write the soft wrapped row's record */
 						new_record.soft_wrapped = 1;
-						_vte_stream_append(new_row_stream, (const char *) &new_record, sizeof (new_record));
+						_vte_row_records_append(&new_row_records, &new_record, new_row_index);
 						_vte_debug_print(VTE_DEBUG_RING,
 								"    New row %ld  text_offset %" G_GSIZE_FORMAT "  attr_offset %" G_GSIZE_FORMAT "  soft_wrapped\n",
 								new_row_index,
@@ -1336,7 +1705,7 @@ _vte_ring_rewrap (VteRing *ring,
 		/* Write the record of the paragraph's last row. */
 		/* Hard wrapped, except maybe at the end of the very last paragraph */
 		new_record.soft_wrapped = prev_record_was_soft_wrapped;
-		_vte_stream_append(new_row_stream, (const char *) &new_record, sizeof (new_record));
+		_vte_row_records_append(&new_row_records, &new_record, new_row_index);
 		_vte_debug_print(VTE_DEBUG_RING,
 				"    New row %ld  text_offset %" G_GSIZE_FORMAT "  attr_offset %" G_GSIZE_FORMAT "\n",
 				new_row_index,
@@ -1355,8 +1724,9 @@ _vte_ring_rewrap (VteRing *ring,
 
 	/* Update the ring. */
 	old_ring_end = ring->end;
-	g_object_unref(ring->row_stream);
-	ring->row_stream = new_row_stream;
+	_vte_row_records_flush(&new_row_records);
+	_vte_row_records_fini(&ring->row_records);
+	ring->row_records = new_row_records;
 	ring->writable = ring->end = new_row_index;
 	ring->start = 0;
 	if (ring->end > ring->max)
@@ -1391,7 +1761,7 @@ err:
 			"Error while rewrapping\n");
 	g_assert_not_reached();
 #endif
-	g_object_unref(new_row_stream);
+	_vte_row_records_fini(&new_row_records);
 	g_free(marker_text_offsets);
 	g_free(new_markers);
 }
@@ -1486,3 +1856,445 @@ _vte_ring_write_contents (VteRing *ring,
 
 	return TRUE;
 }
+
+
+/*
+ * VteRingSnapshot: The frozen rows of a ring, readable from any thread
+ */
+
+struct _VteRingSnapshot {
+        gulong start, end;  /* the rows that were frozen when the snapshot was taken */
+        VteStreamReader *text, *attr, *records, *blocks;
+        gulong records_first, records_end;
+        gsize blocks_origin;
+        gsize last_attr_text_start_offset;
+        VteCellAttr last_attr;
+        GString *buffer;
+
+        /* The last decoded block of row records */
+        gulong cached_block;
+        VteRowRecord cache[VTE_ROW_RECORD_BLOCK_SIZE];
+        gsize cache_offsets[VTE_ROW_RECORD_BLOCK_SIZE];
+};
+
+/**
+ * _vte_ring_snapshot_new:
+ * @ring: a #VteRing
+ *
+ * Pins the rows of @ring that are currently frozen in the streams.  The
+ * ring goes on as usual, but keeps the pinned data on disk until the
+ * snapshot is freed.  The snapshot can be used from any thread, one at a
+ * time.  Reading from it fails once the ring resets or thaws the pinned
+ * rows.  The snapshot holds on to the old row records across rewrapping,
+ * and keeps returning the rows as they were laid out when it was taken.
+ * Rewrapping freezes all of the ring though, so when the ring thaws its
+ * newest rows again afterwards (e.g. as the screen gets written to) and
+ * truncates the streams, some of the newest pinned rows can become
+ * unreadable: reading them returns %FALSE from then on.
+ *
+ * Returns: a new #VteRingSnapshot, or %NULL if @ring has no streams
+ */
+VteRingSnapshot *
+_vte_ring_snapshot_new (VteRing *ring)
+{
+        VteRingSnapshot *snapshot;
+
+        if (!ring->has_streams)
+                return NULL;
+
+        g_assert (ring->row_records.pending->len == 0);
+
+        snapshot = g_new0 (VteRingSnapshot, 1);
+        snapshot->start = ring->start;
+        snapshot->end = ring->writable;
+        snapshot->text = _vte_stream_reader_new (ring->text_stream);
+        snapshot->attr = _vte_stream_reader_new (ring->attr_stream);
+        snapshot->records = _vte_stream_reader_new (ring->row_records.records);
+        snapshot->blocks = _vte_stream_reader_new (ring->row_records.blocks);
+        snapshot->records_first = ring->row_records.first;
+        snapshot->records_end = ring->row_records.end;
+        snapshot->blocks_origin = ring->row_records.blocks_origin;
+        snapshot->last_attr_text_start_offset = ring->last_attr_text_start_offset;
+        snapshot->last_attr = ring->last_attr;
+        if (snapshot->last_attr.hyperlink_idx != 0)
+                snapshot->last_attr.hyperlink_idx = VTE_HYPERLINK_IDX_TARGET_IN_STREAM;
+        snapshot->buffer = g_string_new (NULL);
+        snapshot->cached_block = (gulong) -1;
+
+        return snapshot;
+}
+
+void
+_vte_ring_snapshot_free (VteRingSnapshot *snapshot)
+{
+        _vte_stream_reader_free (snapshot->text);
+        _vte_stream_reader_free (snapshot->attr);
+        _vte_stream_reader_free (snapshot->records);
+        _vte_stream_reader_free (snapshot->blocks);
+        g_string_free (snapshot->buffer, TRUE);
+        g_free (snapshot);
+}
+
+gulong
+_vte_ring_snapshot_start (VteRingSnapshot *snapshot)
+{
+        return snapshot->start;
+}
+
+gulong
+_vte_ring_snapshot_end (VteRingSnapshot *snapshot)
+{
+        return snapshot->end;
+}
+
+static gboolean
+_vte_ring_snapshot_read_row_record (VteRingSnapshot *snapshot, VteRowRecord *record, gulong position)
+{
+        char buf[VTE_ROW_RECORD_BLOCK_BYTES_MAX];
+        gulong block = position / VTE_ROW_RECORD_BLOCK_SIZE;
+        gulong first_row, end_row;
+        gsize offset, len;
+
+        if (position < snapshot->records_first || position >= snapshot->records_end)
+                return FALSE;
+
+        if (snapshot->cached_block != block) {
+                snapshot->cached_block = (gulong) -1;
+
+                first_row = MAX (block * VTE_ROW_RECORD_BLOCK_SIZE, snapshot->records_first);
+                end_row = MIN ((block + 1) * VTE_ROW_RECORD_BLOCK_SIZE, snapshot->records_end);
+
+                if (!_vte_stream_reader_read (snapshot->blocks,
+                                              snapshot->blocks_origin + (block - snapshot->records_first / VTE_ROW_RECORD_BLOCK_SIZE) * sizeof (gsize),
+                                              (char *) &offset, sizeof (offset)))
+                        return FALSE;
+                len = MIN (sizeof (buf), _vte_stream_reader_head (snapshot->records) - offset);
+                if (!_vte_stream_reader_read (snapshot->records, offset, buf, len))
+                        return FALSE;
+                if (!_vte_row_records_decode (buf, len, offset, first_row, end_row, snapshot->cache, snapshot->cache_offsets))
+                        return FALSE;
+
+                snapshot->cached_block = block;
+        }
+
+        *record = snapshot->cache[position % VTE_ROW_RECORD_BLOCK_SIZE];
+        return TRUE;
+}
+
+/* Reads the text of the row at position into buffer, with the '\n' if it's not soft wrapped. */
+static gboolean
+_vte_ring_snapshot_read_row_text (VteRingSnapshot *snapshot, gulong position, VteRowRecord *record, GString *buffer)
+{
+        VteRowRecord next;
+        gsize end_offset;
+
+        if (position < snapshot->start || position >= snapshot->end)
+                return FALSE;
+
+        if (!_vte_ring_snapshot_read_row_record (snapshot, record, position))
+                return FALSE;
+        if (position + 1 < snapshot->records_end) {
+                if (!_vte_ring_snapshot_read_row_record (snapshot, &next, position + 1))
+                        return FALSE;
+                end_offset = next.text_start_offset;
+        } else
+                end_offset = _vte_stream_reader_head (snapshot->text);
+
+        g_string_set_size (buffer, end_offset - record->text_start_offset);
+        return _vte_stream_reader_read (snapshot->text, record->text_start_offset, buffer->str, buffer->len);
+}
+
+/**
+ * _vte_ring_snapshot_read_text:
+ * @snapshot: a #VteRingSnapshot
+ * @position: a row between _vte_ring_snapshot_start() and _vte_ring_snapshot_end()
+ * @text: a #GString
+ *
+ * Appends the UTF-8 text of the row at @position to @text, followed by a
+ * newline unless the row is soft wrapped, just like _vte_ring_write_contents().
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+_vte_ring_snapshot_read_text (VteRingSnapshot *snapshot, gulong position, GString *text)
+{
+        VteRowRecord record;
+
+        if (!_vte_ring_snapshot_read_row_text (snapshot, position, &record, snapshot->buffer))
+                return FALSE;
+
+        g_string_append_len (text, snapshot->buffer->str, snapshot->buffer->len);
+        return TRUE;
+}
+
+/**
+ * _vte_ring_snapshot_thaw_row:
+ * @snapshot: a #VteRingSnapshot
+ * @position: a row between _vte_ring_snapshot_start() and _vte_ring_snapshot_end()
+ * @row: an initialized #VteRowData to store the row in
+ *
+ * Like thawing a row for display, hyperlinked cells get the
+ * VTE_HYPERLINK_IDX_TARGET_IN_STREAM idx.  Combining characters are not
+ * attached to their base character's cell, since that would have to go
+ * through the vteunistr table, which belongs to the main thread; use
+ * _vte_ring_snapshot_read_text() for the exact text.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+_vte_ring_snapshot_thaw_row (VteRingSnapshot *snapshot, gulong position, VteRowData *row)
+{
+	VteRowRecord record;
+	VteCellAttr attr = basic_cell.attr;
+	VteCellAttrChange attr_change;
+	VteCell cell;
+	const char *p, *q, *end;
+	GString *buffer = snapshot->buffer;
+
+	_vte_row_data_clear (row);
+
+	if (!_vte_ring_snapshot_read_row_text (snapshot, position, &record, buffer))
+		return FALSE;
+
+	if (G_LIKELY (buffer->len && buffer->str[buffer->len - 1] == '\n'))
+                g_string_truncate (buffer, buffer->len - 1);
+	else
+		row->attr.soft_wrapped = TRUE;
+
+	attr_change.text_end_offset = 0;
+
+	p = buffer->str;
+	end = p + buffer->len;
+	while (p < end) {
+		if (record.text_start_offset >= snapshot->last_attr_text_start_offset) {
+			attr = snapshot->last_attr;
+		} else if (record.text_start_offset >= attr_change.text_end_offset) {
+			if (!_vte_stream_reader_read (snapshot->attr, record.attr_start_offset, (char *) &attr_change, sizeof (attr_change)))
+				return FALSE;
+			/* Skip the hyperlink target, along with its repeated length */
+			record.attr_start_offset += sizeof (attr_change) + attr_change.attr.hyperlink_length + 2;
+
+			_attrcpy(&attr, &attr_change.attr);
+			attr.hyperlink_idx = attr_change.attr.hyperlink_length ? VTE_HYPERLINK_IDX_TARGET_IN_STREAM : 0;
+		}
+
+		cell.attr = attr;
+		cell.c = g_utf8_get_char (p);
+
+		q = g_utf8_next_char (p);
+		record.text_start_offset += q - p;
+		p = q;
+
+		if (G_UNLIKELY (cell.attr.columns == 0)) {
+			if (G_LIKELY (row->len))
+				continue;
+			cell.attr.columns = 1;
+		}
+		_vte_row_data_append (row, &cell);
+		if (cell.attr.columns > 1) {
+			/* Add the fragments */
+			int i, columns = cell.attr.columns;
+			cell.attr.fragment = 1;
+			cell.attr.columns = 1;
+			for (i = 1; i < columns; i++)
+				_vte_row_data_append (row, &cell);
+		}
+	}
+
+	return TRUE;
+}
+
+#ifdef RING_MAIN
+
+#include <stdio.h>
+
+/* Fills the row at position with "row <position>" and some padding, bold
+ * on odd rows, followed by a double width character on every third row. */
+static void
+test_fill_row (VteRowData *row, gulong position, GString *expected)
+{
+	VteCell cell = basic_cell;
+	char text[32];
+	int i, len;
+
+	len = g_snprintf (text, sizeof (text), "row %lu", position);
+	cell.attr.bold = position % 2;
+	for (i = 0; i < len; i++) {
+		cell.c = text[i];
+		_vte_row_data_append (row, &cell);
+	}
+	g_string_append (expected, text);
+
+	/* Enough to fill several blocks of the text stream */
+	cell.c = 'x';
+	for (i = 0; i < (int) (position % 61) + 40; i++) {
+		_vte_row_data_append (row, &cell);
+		g_string_append_c (expected, 'x');
+	}
+
+	if (position % 3 == 0) {
+		cell.c = 0x4e2d;
+		cell.attr.columns = 2;
+		_vte_row_data_append (row, &cell);
+		cell.attr.fragment = 1;
+		cell.attr.columns = 1;
+		_vte_row_data_append (row, &cell);
+		g_string_append_unichar (expected, 0x4e2d);
+	}
+
+	row->attr.soft_wrapped = position % 5 == 0;
+	if (!row->attr.soft_wrapped)
+		g_string_append_c (expected, '\n');
+}
+
+/* Checks the row at position of the snapshot, as far as it can be read.
+ * Returns how many of its text and its cells could be read. */
+static int
+test_check_snapshot_row (VteRingSnapshot *snapshot, gulong position)
+{
+	GString *expected = g_string_new (NULL);
+	GString *text = g_string_new (NULL);
+	VteRowData row, reference;
+	int readable = 0;
+	guint i;
+
+	_vte_row_data_init (&row);
+	_vte_row_data_init (&reference);
+	test_fill_row (&reference, position, expected);
+
+	if (_vte_ring_snapshot_read_text (snapshot, position, text)) {
+		g_assert_cmpstr (text->str, ==, expected->str);
+		readable++;
+	}
+
+	if (_vte_ring_snapshot_thaw_row (snapshot, position, &row)) {
+		g_assert_cmpuint (row.len, ==, reference.len);
+		g_assert_cmpuint (row.attr.soft_wrapped, ==, reference.attr.soft_wrapped);
+		for (i = 0; i < row.len; i++) {
+			const VteCell *cell = _vte_row_data_get (&row, i);
+			const VteCell *ref = _vte_row_data_get (&reference, i);
+			g_assert_cmpuint (cell->c, ==, ref->c);
+			g_assert_cmpuint (cell->attr.columns, ==, ref->attr.columns);
+			g_assert_cmpuint (cell->attr.fragment, ==, ref->attr.fragment);
+			g_assert_cmpuint (cell->attr.bold, ==, ref->attr.bold);
+		}
+		readable++;
+	}
+
+	_vte_row_data_fini (&row);
+	_vte_row_data_fini (&reference);
+	g_string_free (expected, TRUE);
+	g_string_free (text, TRUE);
+	return readable;
+}
+
+static void
+test_assert_snapshot (VteRingSnapshot *snapshot)
+{
+	gulong position;
+
+	for (position = _vte_ring_snapshot_start (snapshot);
+	     position < _vte_ring_snapshot_end (snapshot);
+	     position++)
+		g_assert_cmpint (test_check_snapshot_row (snapshot, position), ==, 2);
+}
+
+static void
+test_snapshot (void)
+{
+	VteRing ring;
+	VteRingSnapshot *snapshot;
+	VteVisualPosition *markers[] = { NULL };
+	GString *scratch = g_string_new (NULL);
+	GString *text = g_string_new (NULL);
+	gulong position;
+
+	_vte_ring_init (&ring, 2000, TRUE);
+
+	/* Enough rows for most of them to be frozen, and some scrolled out */
+	for (position = 0; position < 3000; position++)
+		test_fill_row (_vte_ring_append (&ring), position, scratch);
+
+	snapshot = _vte_ring_snapshot_new (&ring);
+	g_assert_nonnull (snapshot);
+	g_assert_cmpuint (_vte_ring_snapshot_start (snapshot), ==, 1000);
+	g_assert_cmpuint (_vte_ring_snapshot_start (snapshot), <, _vte_ring_snapshot_end (snapshot));
+	test_assert_snapshot (snapshot);
+
+	/* Rows outside the snapshot can't be read */
+	g_assert_false (_vte_ring_snapshot_read_text (snapshot, _vte_ring_snapshot_start (snapshot) - 1, text));
+	g_assert_false (_vte_ring_snapshot_read_text (snapshot, _vte_ring_snapshot_end (snapshot), text));
+
+	/* The snapshot keeps its rows while the ring scrolls them out */
+	for (; position < 7000; position++)
+		test_fill_row (_vte_ring_append (&ring), position, scratch);
+	g_assert_cmpuint (_vte_ring_delta (&ring), >, _vte_ring_snapshot_end (snapshot));
+	test_assert_snapshot (snapshot);
+
+	/* Rewrapping the ring doesn't affect the rows as the snapshot has them */
+	_vte_ring_rewrap (&ring, 4, markers);
+	test_assert_snapshot (snapshot);
+
+	/* Resetting the ring throws away what the snapshot pinned */
+	_vte_ring_reset (&ring);
+	g_assert_false (_vte_ring_snapshot_read_text (snapshot, _vte_ring_snapshot_start (snapshot), text));
+
+	_vte_ring_snapshot_free (snapshot);
+	_vte_ring_fini (&ring);
+	g_string_free (scratch, TRUE);
+	g_string_free (text, TRUE);
+}
+
+static void
+test_snapshot_rewrap (void)
+{
+	VteRing ring;
+	VteRingSnapshot *snapshot;
+	VteVisualPosition *markers[] = { NULL };
+	GString *scratch = g_string_new (NULL);
+	gulong position, unreadable;
+
+	_vte_ring_init (&ring, 2000, TRUE);
+
+	for (position = 0; position < 3000; position++)
+		test_fill_row (_vte_ring_append (&ring), position, scratch);
+
+	snapshot = _vte_ring_snapshot_new (&ring);
+	g_assert_nonnull (snapshot);
+
+	/* Resize while the snapshot still has rows in the ring */
+	_vte_ring_rewrap (&ring, 40, markers);
+	test_assert_snapshot (snapshot);
+
+	/* Write to all of the ring's rows again, which truncates the streams
+	 * back into the blocks holding the newest pinned rows */
+	_vte_ring_index_writable (&ring, _vte_ring_delta (&ring));
+
+	/* The oldest rows are still there, some newer ones can't be read,
+	 * and whatever can be read is what the snapshot had */
+	g_assert_cmpint (test_check_snapshot_row (snapshot, _vte_ring_snapshot_start (snapshot)), ==, 2);
+	unreadable = 0;
+	for (position = _vte_ring_snapshot_start (snapshot);
+	     position < _vte_ring_snapshot_end (snapshot);
+	     position++) {
+		if (test_check_snapshot_row (snapshot, position) < 2)
+			unreadable++;
+	}
+	g_assert_cmpuint (unreadable, >, 0);
+
+	_vte_ring_snapshot_free (snapshot);
+	_vte_ring_fini (&ring);
+	g_string_free (scratch, TRUE);
+}
+
+int
+main (int argc, char **argv)
+{
+	test_snapshot ();
+	test_snapshot_rewrap ();
+
+	printf ("ring tests passed :)\n");
+	return 0;
+}
+
+#endif /* RING_MAIN */
@@ -44,6 +44,38 @@ typedef struct _VteCellAttrChange {
 } VteCellAttrChange;
 
 
+/*
+ * VteRowRecordStream: The index of the frozen rows
+ *
+ * Rows are grouped in blocks of VTE_ROW_RECORD_BLOCK_SIZE.  The first record
+ * of a block stores its offsets absolutely, the others as varint encoded
+ * deltas to the previous row, with the two flags folded into the text offset.
+ * blocks holds the offset in records of each block, so any row can be found
+ * by decoding at most one block.
+ */
+
+typedef struct _VteRowRecord {
+	gsize text_start_offset;  /* offset where text of this row begins */
+	gsize attr_start_offset;  /* offset of the first character's attributes */
+	int soft_wrapped: 1;      /* end of line is not '\n' */
+	int is_ascii: 1;          /* for rewrapping speedup: guarantees that line contains 32..126 bytes only. Can be 0 even when ascii only. */
+} VteRowRecord;
+
+#define VTE_ROW_RECORD_BLOCK_SIZE 16
+
+typedef struct _VteRowRecordStream {
+        VteStream *records, *blocks;
+        gsize blocks_origin;    /* offset in blocks of the block of first */
+        gulong first, end;      /* rows stored since the last reset */
+        gsize last_text_offset, last_attr_offset;  /* of the row before end */
+        GString *pending, *pending_blocks;  /* appended, but not yet written to the streams */
+
+        /* The last decoded block */
+        gulong cached_block;
+        VteRowRecord cache[VTE_ROW_RECORD_BLOCK_SIZE];
+        gsize cache_offsets[VTE_ROW_RECORD_BLOCK_SIZE];
+} VteRowRecordStream;
+
 /*
  * VteRing: A scrollback buffer ring
  */
@@ -60,7 +92,7 @@ struct _VteRing {
 
         /* Storage:
          *
-         * row_stream contains records of VteRowRecord for each physical row.
+         * row_records contains a VteRowRecord for each physical row.
          * (This stream is regenerated when the contents rewrap on resize.)
          *
          * text_stream is the text in UTF-8.
@@ -72,16 +104,19 @@ struct _VteRing {
          *    if nonempty, it actually contains the ID and URI separated with a semicolon. Not NUL terminated.
          *  - 2 bytes repeating attr.hyperlink_length so that we can walk backwards.
          */
-	VteStream *attr_stream, *text_stream, *row_stream;
+	VteStream *attr_stream, *text_stream;
+        VteRowRecordStream row_records;
 	gsize last_attr_text_start_offset;
 	VteCellAttr last_attr;
 	GString *utf8_buffer;
+        GString *freeze_text_buffer, *freeze_attr_buffer;  /* rows being frozen in a batch */
 
 	VteRowData cached_row;
 	gulong cached_row_num;
 
 	gboolean has_streams;
         gulong visible_rows;  /* to keep at least a screenful of lines in memory, bug 646098 comment 12 */
+        gulong stream_reads;  /* bumped on every lookup of a frozen row, to tell whether the scrollback is in use */
 
         GPtrArray *hyperlinks;  /* The hyperlink pool. Contains GString* items.
                                    [0] points to an empty GString, [1] to [VTE_HYPERLINK_COUNT_MAX] contain the id;uri pairs. */
@@ -112,9 +147,12 @@ hyperlink_idx_t _vte_ring_get_hyperlink_at_position (VteRing *ring, gulong posit
 long _vte_ring_reset (VteRing *ring);
 void _vte_ring_resize (VteRing *ring, gulong max_rows);
 void _vte_ring_shrink (VteRing *ring, gulong max_len);
+void _vte_ring_trim (VteRing *ring);
+gsize _vte_ring_get_buffer_size (VteRing *ring);
 VteRowData *_vte_ring_insert (VteRing *ring, gulong position);
 VteRowData *_vte_ring_append (VteRing *ring);
 void _vte_ring_remove (VteRing *ring, gulong position);
+void _vte_ring_rotate (VteRing *ring, gulong start, gulong end, glong count);
 void _vte_ring_drop_scrollback (VteRing *ring, gulong position);
 void _vte_ring_set_visible_rows (VteRing *ring, gulong rows);
 void _vte_ring_rewrap (VteRing *ring, glong columns, VteVisualPosition **markers);
@@ -124,6 +162,19 @@ gboolean _vte_ring_write_contents (VteRing *ring,
 				   GCancellable *cancellable,
 				   GError **error);
 
+/*
+ * VteRingSnapshot: A read-only view of the frozen rows of a ring
+ */
+
+typedef struct _VteRingSnapshot VteRingSnapshot;
+
+VteRingSnapshot *_vte_ring_snapshot_new (VteRing *ring);
+void _vte_ring_snapshot_free (VteRingSnapshot *snapshot);
+gulong _vte_ring_snapshot_start (VteRingSnapshot *snapshot);
+gulong _vte_ring_snapshot_end (VteRingSnapshot *snapshot);
+gboolean _vte_ring_snapshot_read_text (VteRingSnapshot *snapshot, gulong position, GString *text);
+gboolean _vte_ring_snapshot_thaw_row (VteRingSnapshot *snapshot, gulong position, VteRowData *row);
+
 G_END_DECLS
 
 #endif
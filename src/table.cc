@@ -26,7 +26,9 @@
 #include <glib.h>
 #include <glib-object.h>
 #include "debug.h"
+#include "caps.h"
 #include "iso2022.h"
+#include "matcher.h"
 #include "table.h"
 
 /* Table info. */
@@ -41,7 +43,7 @@
 struct _vte_table {
 	struct _vte_matcher_impl impl;
 	const char *result;
-	unsigned char *original;
+	const char *original;
 	gssize original_length;
 	struct _vte_table *table_string;
 	struct _vte_table *table_number;
@@ -182,7 +184,7 @@ _vte_table_free(struct _vte_table *table)
 		g_assert(table->original != NULL);
 	}
 	if (table->original != NULL) {
-		g_free(table->original);
+		g_free((gpointer) table->original);
 	}
 	g_slice_free(struct _vte_table, table);
 }
@@ -213,9 +215,9 @@ _vte_table_addi(struct _vte_table *table,
 
 		table->result = g_intern_string(result);
 		if (table->original != NULL) {
-			g_free(table->original);
+			g_free((gpointer) table->original);
 		}
-		table->original = (unsigned char *) g_memdup(original, original_length);
+		table->original = (const char *) g_memdup(original, original_length);
 		table->original_length = original_length;
 		return;
 	}
@@ -394,7 +396,7 @@ static const char *
 _vte_table_matchi(struct _vte_table *table,
 		  const gunichar *candidate, gssize length,
 		  const char **res, const gunichar **consumed,
-		  unsigned char **original, gssize *original_length,
+		  const char **original, gssize *original_length,
 		  struct _vte_table_arginfo_head *params)
 {
 	int i = 0;
@@ -587,7 +589,7 @@ _vte_table_match(struct _vte_table *table,
 	const char *dummy_res;
 	GValueArray *dummy_array;
 	const char *ret;
-	unsigned char *original, *p;
+	const char *original, *p;
 	gssize original_length;
 	int i;
 	struct _vte_table_arginfo_head params;
@@ -746,6 +748,205 @@ _vte_table_print(struct _vte_table *table)
 		count, (long) count * sizeof(struct _vte_table));
 }
 
+#ifdef TABLE_GENERATE
+/* Builds the tree of all the sequences in caps.cc and writes it out as static
+ * data, see matcher-tables.h in the Makefile.  Identical subtrees, which are
+ * plentiful once the C1 variants are added, are only emitted once. */
+
+struct _vte_table_generator {
+	GHashTable *nodes;	/* initializer text -> index + 1 */
+	GHashTable *literals;
+	GString *nodes_text;
+	GString *literals_text;
+};
+
+static void
+_vte_table_generate_bytes(GString *out, const char *bytes, gssize length)
+{
+	gssize i;
+
+	g_string_append_c(out, '"');
+	for (i = 0; i < length; i++) {
+		guint8 c = bytes[i];
+		if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\' && c != '?') {
+			g_string_append_c(out, c);
+		} else {
+			g_string_append_printf(out, "\\%03o", c);
+		}
+	}
+	g_string_append_c(out, '"');
+}
+
+/* Returns the index of @text in @table, adding it to @out if it's new. */
+static guint
+_vte_table_generate_intern(GHashTable *table, GString *out, GString *text)
+{
+	gpointer index;
+
+	index = g_hash_table_lookup(table, text->str);
+	if (index == NULL) {
+		index = GUINT_TO_POINTER(g_hash_table_size(table) + 1);
+		g_hash_table_insert(table, g_strdup(text->str), index);
+		g_string_append_printf(out, "\t%s, /* %u */\n",
+				       text->str, GPOINTER_TO_UINT(index) - 1);
+	}
+	return GPOINTER_TO_UINT(index) - 1;
+}
+
+static void
+_vte_table_generate_ref(struct _vte_table_generator *gen, GString *out,
+			struct _vte_table *table);
+
+static guint
+_vte_table_generate_node(struct _vte_table_generator *gen,
+			 struct _vte_table *table)
+{
+	GString *text;
+	guint i, index;
+
+	text = g_string_new("{ { &_vte_matcher_table }, ");
+	if (table->result != NULL) {
+		_vte_table_generate_bytes(text, table->result, strlen(table->result));
+		g_string_append(text, ", ");
+		_vte_table_generate_bytes(text, table->original, table->original_length);
+	} else {
+		g_string_append(text, "NULL, NULL");
+	}
+	g_string_append_printf(text, ", %" G_GSSIZE_FORMAT ", ", table->original_length);
+	_vte_table_generate_ref(gen, text, table->table_string);
+	g_string_append(text, ", ");
+	_vte_table_generate_ref(gen, text, table->table_number);
+	g_string_append(text, ", ");
+	_vte_table_generate_ref(gen, text, table->table_number_list);
+	g_string_append(text, ", ");
+	if (table->table != NULL) {
+		GString *literal = g_string_new("{ ");
+		for (i = 0; i < VTE_TABLE_MAX_LITERAL; i++) {
+			if (i > 0)
+				g_string_append(literal, i % 16 ? ", " : ",\n\t  ");
+			_vte_table_generate_ref(gen, literal, table->table[i]);
+		}
+		g_string_append(literal, " }");
+		index = _vte_table_generate_intern(gen->literals, gen->literals_text, literal);
+		g_string_append_printf(text, "LITERALS(%u)", index);
+		g_string_free(literal, TRUE);
+	} else {
+		g_string_append(text, "NULL");
+	}
+	g_string_append(text, " }");
+
+	index = _vte_table_generate_intern(gen->nodes, gen->nodes_text, text);
+	g_string_free(text, TRUE);
+	return index;
+}
+
+static void
+_vte_table_generate_ref(struct _vte_table_generator *gen, GString *out,
+			struct _vte_table *table)
+{
+	if (table == NULL) {
+		g_string_append(out, "NULL");
+	} else {
+		g_string_append_printf(out, "NODE(%u)", _vte_table_generate_node(gen, table));
+	}
+}
+
+/* Adds every sequence in caps.cc, along with its C1 variants. */
+static void
+_vte_table_add_capabilities(struct _vte_table *table)
+{
+	const char *code, *value;
+        char *c1;
+        int i, k, n, variants;
+
+        code = _vte_xterm_capability_strings;
+        do {
+                value = strchr(code, '\0') + 1;
+
+                /* Escape sequences from \e@ to \e_ have a C1 counterpart
+                 * with the eighth bit set instead of a preceding '\x1b'.
+                 * This is encoded in the current encoding, e.g. in UTF-8
+                 * the C1 CSI (U+009B) becomes \xC2\x9B.
+                 *
+                 * When matching, the bytestream is already decoded to
+                 * Unicode codepoints.  In the "code" string, each byte
+                 * is interpreted as a Unicode codepoint (in other words,
+                 * Latin-1 is assumed).  So '\x80' .. '\x9F' bytes
+                 * (e.g. the byte '\x9B' for CSI) are the right choice here.
+                 *
+                 * For each sequence containing N occurrences of \e@ to \e_,
+                 * we create 2^N variants, by replacing every subset of them
+                 * with their C1 counterpart.
+                 */
+                variants = 1;
+                for (i = 0; code[i] != '\0'; i++) {
+                        if (code[i] == '\x1B' && code[i + 1] >= '@' && code[i + 1] <= '_') {
+                                variants <<= 1;
+                        }
+                }
+                for (n = 0; n < variants; n++) {
+                        c1 = g_strdup(code);
+                        k = 0;
+                        for (i = 0; c1[i] != '\0'; i++) {
+                                if (c1[i] == '\x1B' && c1[i + 1] >= '@' && c1[i + 1] <= '_') {
+                                        if (n & (1 << k)) {
+                                                memmove(c1 + i, c1 + i + 1, strlen(c1 + i + 1) + 1);
+                                                c1[i] += 0x40;
+                                        }
+                                        k++;
+                                }
+                        }
+                        _vte_table_add(table, c1, strlen(c1), value);
+                        g_free(c1);
+                }
+
+                code = strchr(value, '\0') + 1;
+        } while (*code);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct _vte_table_generator gen;
+	struct _vte_table *table;
+	guint root;
+
+	table = _vte_table_new();
+	_vte_table_add_capabilities(table);
+
+	gen.nodes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	gen.literals = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	gen.nodes_text = g_string_new(NULL);
+	gen.literals_text = g_string_new(NULL);
+	root = _vte_table_generate_node(&gen, table);
+
+	printf("/* Generated file.  Do not edit */\n\n"
+	       "#define NODE(n) const_cast<struct _vte_table *>(&_vte_table_static.nodes[n])\n"
+	       "#define LITERALS(n) const_cast<struct _vte_table **>(_vte_table_static.literals[n])\n\n"
+	       "#define VTE_TABLE_STATIC_ROOT %u\n\n"
+	       "struct _vte_table_static_data {\n"
+	       "\tstruct _vte_table nodes[%u];\n"
+	       "\tstruct _vte_table *literals[%u][VTE_TABLE_MAX_LITERAL];\n"
+	       "};\n\n"
+	       "static const struct _vte_table_static_data _vte_table_static = {\n"
+	       "{\n%s},\n{\n%s}\n};\n\n"
+	       "#undef NODE\n"
+	       "#undef LITERALS\n",
+	       root,
+	       g_hash_table_size(gen.nodes),
+	       g_hash_table_size(gen.literals),
+	       gen.nodes_text->str,
+	       gen.literals_text->str);
+
+	g_hash_table_destroy(gen.nodes);
+	g_hash_table_destroy(gen.literals);
+	g_string_free(gen.nodes_text, TRUE);
+	g_string_free(gen.literals_text, TRUE);
+	_vte_table_free(table);
+	return 0;
+}
+#endif
+
 #ifdef TABLE_MAIN
 /* Return an escaped version of a string suitable for printing. */
 static char *
@@ -822,6 +1023,54 @@ print_array(GValueArray *array)
 	}
 }
 
+/* A long string sequence is recognised as such while it is incomplete, with
+ * either form of introducer, and matches once its terminator arrives. */
+static void
+test_string_sequence(const gunichar *introducer, gsize introducer_len)
+{
+	struct _vte_matcher *matcher;
+	const char *result;
+	const gunichar *consumed;
+	GValueArray *array;
+	gunichar *seq;
+	gsize i, len;
+
+	len = introducer_len + 2 + 100000;
+	seq = g_new(gunichar, len + 1);
+	memcpy(seq, introducer, introducer_len * sizeof(gunichar));
+	seq[introducer_len] = '0';
+	seq[introducer_len + 1] = ';';
+	for (i = introducer_len + 2; i < len; i++)
+		seq[i] = 'a' + i % 26;
+
+	/* Only the number so far, which could still be OSC 50;#n */
+	g_assert(!_vte_matcher_is_partial_string(seq, introducer_len));
+	g_assert(!_vte_matcher_is_partial_string(seq, introducer_len + 2));
+	g_assert(_vte_matcher_is_partial_string(seq, introducer_len + 3));
+	g_assert(_vte_matcher_is_partial_string(seq, len));
+
+	matcher = _vte_matcher_new();
+
+	array = NULL;
+	_vte_matcher_match(matcher, seq, len, &result, &consumed, &array);
+	g_assert(result != NULL && result[0] == '\0');
+	g_assert(consumed == seq + len);
+	if (array != NULL)
+		_vte_matcher_free_params_array(matcher, array);
+
+	/* The C1 ST */
+	seq[len] = 0x9c;
+	array = NULL;
+	_vte_matcher_match(matcher, seq, len + 1, &result, &consumed, &array);
+	g_assert_cmpstr(result, ==, "set-icon-and-window-title");
+	g_assert(consumed == seq + len + 1);
+	if (array != NULL)
+		_vte_matcher_free_params_array(matcher, array);
+
+	_vte_matcher_free(matcher);
+	g_free(seq);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -882,6 +1131,21 @@ main(int argc, char **argv)
 		g_free(candidate);
 	}
 	_vte_table_free(table);
+
+	const gunichar osc_7bit[] = { 0x1b, ']' };
+	const gunichar osc_c1[] = { 0x9d };
+	const gunichar dcs_7bit[] = { 0x1b, 'P' };
+	const gunichar dcs_c1[] = { 0x90 };
+	const gunichar not_dcs[] = { 'P' };
+
+	test_string_sequence(osc_7bit, G_N_ELEMENTS(osc_7bit));
+	test_string_sequence(osc_c1, G_N_ELEMENTS(osc_c1));
+	g_assert(_vte_matcher_is_partial_string(dcs_7bit, G_N_ELEMENTS(dcs_7bit)));
+	g_assert(_vte_matcher_is_partial_string(dcs_c1, G_N_ELEMENTS(dcs_c1)));
+	g_assert(!_vte_matcher_is_partial_string(dcs_7bit, 1));
+	g_assert(!_vte_matcher_is_partial_string(not_dcs, G_N_ELEMENTS(not_dcs)));
+	printf("\nString sequences: OK\n");
+
 	return 0;
 }
 #endif
@@ -893,3 +1157,14 @@ const struct _vte_matcher_class _vte_matcher_table = {
 	(_vte_matcher_match_func)_vte_table_match,
 	(_vte_matcher_destroy_func)_vte_table_free
 };
+
+#ifndef TABLE_GENERATE
+#include "matcher-tables.h"
+
+/* The tree of all known sequences, built at compile time. */
+struct _vte_matcher_impl *
+_vte_table_get_static(void)
+{
+	return (struct _vte_matcher_impl *) &_vte_table_static.nodes[VTE_TABLE_STATIC_ROOT];
+}
+#endif
@@ -47,6 +47,9 @@ const char *_vte_table_match(struct _vte_table *table,
 /* Dump out the contents of a tree. */
 void _vte_table_print(struct _vte_table *table);
 
+/* The tree of all the sequences in caps.cc, generated at build time. */
+struct _vte_matcher_impl *_vte_table_get_static(void);
+
 extern const struct _vte_matcher_class _vte_matcher_table;
 
 G_END_DECLS
@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/param.h> /* howmany() */
 #include <errno.h>
 #include <fcntl.h>
@@ -129,59 +130,129 @@ _vte_unichar_width(gunichar c, int utf8_ambiguous_width)
 }
 
 /* process incoming data without copying */
-static struct _vte_incoming_chunk *free_chunks;
+
+/* Incoming data is queued oldest chunk first in m_incoming.  By default
+ * every chunk comes from the heap and is freed as soon as it's released.
+ * With VTE_INPUT_HUGE_PAGES=1 in the environment, the chunks are instead
+ * carved out of a per-terminal arena: one contiguous region, aligned to
+ * its size, mapped when first needed and advised to be backed by a huge
+ * page.  This saves TLB misses under heavy output, but the huge page stays
+ * resident for as long as the region is mapped, so it is opt-in.  When a
+ * burst needs more than the region holds the extra chunks come from the
+ * heap, and the region itself is unmapped once the terminal has been idle
+ * for a while, so buffered memory stays bounded.
+ */
+
+#define VTE_INPUT_ARENA_SIZE (VTE_INPUT_ARENA_CHUNKS * VTE_INPUT_CHUNK_SIZE)
+
+static bool
+_vte_incoming_arena_enabled(void)
+{
+        static int enabled = -1;
+
+        if (G_UNLIKELY(enabled == -1)) {
+                char const* env = g_getenv("VTE_INPUT_HUGE_PAGES");
+                enabled = env != nullptr && g_str_equal(env, "1");
+        }
+        return enabled;
+}
+
+static bool
+_vte_incoming_arena_owns(struct _vte_incoming_arena *arena,
+                         struct _vte_incoming_chunk *chunk)
+{
+        return arena->region != nullptr &&
+                (guchar *)chunk >= arena->region &&
+                (guchar *)chunk < arena->region + VTE_INPUT_ARENA_SIZE;
+}
+
+static void
+_vte_incoming_arena_map(struct _vte_incoming_arena *arena)
+{
+        /* Map twice the size and trim it down to an aligned region, so
+         * that it can actually be backed by a single huge page. */
+        void *mapping = mmap(nullptr, 2 * VTE_INPUT_ARENA_SIZE,
+                             PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS,
+                             -1, 0);
+        if (mapping == MAP_FAILED)
+                return;
+
+        auto start = (guchar *)mapping;
+        auto region = (guchar *)(((guintptr)start + VTE_INPUT_ARENA_SIZE - 1) &
+                                 ~((guintptr)VTE_INPUT_ARENA_SIZE - 1));
+        if (region > start)
+                munmap(start, region - start);
+        if (region + VTE_INPUT_ARENA_SIZE < start + 2 * VTE_INPUT_ARENA_SIZE)
+                munmap(region + VTE_INPUT_ARENA_SIZE,
+                       start + 2 * VTE_INPUT_ARENA_SIZE - (region + VTE_INPUT_ARENA_SIZE));
+
+#ifdef MADV_HUGEPAGE
+        madvise(region, VTE_INPUT_ARENA_SIZE, MADV_HUGEPAGE);
+#endif
+
+        arena->region = region;
+        arena->free_chunks = nullptr;
+        for (int i = VTE_INPUT_ARENA_CHUNKS - 1; i >= 0; i--) {
+                auto chunk = (struct _vte_incoming_chunk *)(arena->region + i * VTE_INPUT_CHUNK_SIZE);
+                chunk->next = arena->free_chunks;
+                arena->free_chunks = chunk;
+        }
+}
+
+/* Unmaps the region if none of its chunks are in use. */
+static void
+_vte_incoming_arena_trim(struct _vte_incoming_arena *arena)
+{
+        if (arena->region == nullptr || arena->n_region_used != 0)
+                return;
+
+        _vte_debug_print(VTE_DEBUG_IO, "Unmapping incoming chunk arena.\n");
+        munmap(arena->region, VTE_INPUT_ARENA_SIZE);
+        arena->region = nullptr;
+        arena->free_chunks = nullptr;
+}
+
 static struct _vte_incoming_chunk *
-get_chunk (void)
+get_chunk (struct _vte_incoming_arena *arena)
 {
-	struct _vte_incoming_chunk *chunk = NULL;
-	if (free_chunks) {
-		chunk = free_chunks;
-		free_chunks = free_chunks->next;
-	}
-	if (chunk == NULL) {
+	struct _vte_incoming_chunk *chunk;
+
+        if (arena->region == nullptr && _vte_incoming_arena_enabled())
+                _vte_incoming_arena_map(arena);
+
+	if (arena->free_chunks) {
+		chunk = arena->free_chunks;
+		arena->free_chunks = chunk->next;
+                arena->n_region_used++;
+	} else {
 		chunk = g_new (struct _vte_incoming_chunk, 1);
+                arena->n_heap_used++;
 	}
 	chunk->next = NULL;
 	chunk->len = 0;
 	return chunk;
 }
 static void
-release_chunk (struct _vte_incoming_chunk *chunk)
+release_chunk (struct _vte_incoming_arena *arena,
+               struct _vte_incoming_chunk *chunk)
 {
-	chunk->next = free_chunks;
-	chunk->len = free_chunks ? free_chunks->len + 1 : 0;
-	free_chunks = chunk;
-}
-static void
-prune_chunks (guint len)
-{
-	struct _vte_incoming_chunk *chunk = NULL;
-	if (len && free_chunks != NULL) {
-	    if (free_chunks->len > len) {
-		struct _vte_incoming_chunk *last;
-		chunk = free_chunks;
-		while (free_chunks->len > len) {
-		    last = free_chunks;
-		    free_chunks = free_chunks->next;
-		}
-		last->next = NULL;
-	    }
-	} else {
-	    chunk = free_chunks;
-	    free_chunks = NULL;
-	}
-	while (chunk != NULL) {
-		struct _vte_incoming_chunk *next = chunk->next;
-		g_free (chunk);
-		chunk = next;
-	}
+        if (_vte_incoming_arena_owns(arena, chunk)) {
+                chunk->next = arena->free_chunks;
+                arena->free_chunks = chunk;
+                arena->n_region_used--;
+        } else {
+                g_free(chunk);
+                arena->n_heap_used--;
+        }
 }
 static void
-_vte_incoming_chunks_release (struct _vte_incoming_chunk *chunk)
+_vte_incoming_chunks_release (struct _vte_incoming_arena *arena,
+                              struct _vte_incoming_chunk *chunk)
 {
 	while (chunk) {
 		struct _vte_incoming_chunk *next = chunk->next;
-		release_chunk (chunk);
+		release_chunk (arena, chunk);
 		chunk = next;
 	}
 }
@@ -205,18 +276,6 @@ _vte_incoming_chunks_count (struct _vte_incoming_chunk *chunk)
 	}
 	return cnt;
 }
-static struct _vte_incoming_chunk *
-_vte_incoming_chunks_reverse(struct _vte_incoming_chunk *chunk)
-{
-	struct _vte_incoming_chunk *prev = NULL;
-	while (chunk) {
-		struct _vte_incoming_chunk *next = chunk->next;
-		chunk->next = prev;
-		prev = chunk;
-		chunk = next;
-	}
-	return prev;
-}
 
 static void
 vte_g_array_fill(GArray *array, gconstpointer item, guint final_size)
@@ -262,6 +321,33 @@ VteTerminalPrivate::ring_remove(vte::grid::row_t position)
 	_vte_ring_remove(m_screen->row_data, position);
 }
 
+/* Rotates the rows in [start, end] by count (positive moves them down),
+ * creating missing rows first and filling the vacated ones with the
+ * background color like ring_insert() does. */
+void
+VteTerminalPrivate::ring_rotate(vte::grid::row_t start,
+                                vte::grid::row_t end,
+                                vte::grid::row_t count)
+{
+	VteRing *ring = m_screen->row_data;
+
+        if (start > end || count == 0)
+                return;
+
+        while (_vte_ring_next(ring) <= end)
+                ring_append(false);
+
+        _vte_ring_rotate(ring, start, end + 1, count);
+
+        if (m_fill_defaults.attr.back != VTE_DEFAULT_BG) {
+                auto n = MIN(ABS(count), end - start + 1);
+                auto first = count > 0 ? start : end - n + 1;
+                for (auto i = first; i < first + n; i++)
+                        _vte_row_data_fill(_vte_ring_index_writable(ring, i),
+                                           &m_fill_defaults, m_column_count);
+        }
+}
+
 /* Reset defaults for character insertion. */
 void
 VteTerminalPrivate::reset_default_attributes(bool reset_hyperlink)
@@ -707,22 +793,84 @@ VteTerminalPrivate::invalidate_cursor_once(bool periodic)
 	}
 }
 
-/* Invalidate the cursor repeatedly. */
-// FIXMEchpe this continually adds and removes the blink timeout. Find a better solution
+/* All terminals with a blinking cursor share one timeout.  Blinks happen on
+ * multiples of the blink cycle in monotonic time, so terminals with the same
+ * cycle (usually all of them) blink together and cost a single wakeup, and
+ * the timeout goes away when no terminal is blinking. */
+static GList *g_blinking_terminals = nullptr;
+static guint cursor_blink_timeout_tag = 0;
+static gint64 cursor_blink_timeout_time = 0;
+
+static void schedule_cursor_blink_timeout(void);
+
+/* Returns the first blink boundary at least half a cycle after @now, so
+ * the cursor stays on for a while after being reset. */
+static gint64
+cursor_blink_boundary(gint64 now,
+                      gint cycle)
+{
+        gint64 period = MAX(cycle, 1) * (gint64) 1000;
+
+        return ((now + period / 2) / period + 1) * period;
+}
+
 static gboolean
-invalidate_cursor_periodic_cb(VteTerminalPrivate *that)
+cursor_blink_timeout_cb(gpointer data)
 {
-        that->invalidate_cursor_periodic();
+        GList *l, *next;
+        /* Timeouts have millisecond resolution */
+        gint64 now = g_get_monotonic_time() + 1000;
+
+        cursor_blink_timeout_tag = 0;
+
+        for (l = g_blinking_terminals; l != nullptr; l = next) {
+                auto that = reinterpret_cast<VteTerminalPrivate*>(l->data);
+
+                next = l->next; /* the terminal may stop blinking */
+                if (that->m_cursor_blink_next <= now)
+                        that->invalidate_cursor_periodic();
+        }
+
+        schedule_cursor_blink_timeout();
+
         return G_SOURCE_REMOVE;
 }
 
+static void
+schedule_cursor_blink_timeout(void)
+{
+        GList *l;
+        gint64 first = G_MAXINT64, now;
+
+        for (l = g_blinking_terminals; l != nullptr; l = l->next) {
+                auto that = reinterpret_cast<VteTerminalPrivate*>(l->data);
+                first = MIN(first, that->m_cursor_blink_next);
+        }
+
+        if (cursor_blink_timeout_tag != 0) {
+                if (first >= cursor_blink_timeout_time)
+                        return;
+                g_source_remove(cursor_blink_timeout_tag);
+                cursor_blink_timeout_tag = 0;
+        }
+        if (g_blinking_terminals == nullptr)
+                return;
+
+        now = g_get_monotonic_time();
+        cursor_blink_timeout_time = first;
+        cursor_blink_timeout_tag = g_timeout_add_full(G_PRIORITY_LOW,
+                                                      first > now ? (first - now + 999) / 1000 : 0,
+                                                      cursor_blink_timeout_cb,
+                                                      nullptr, nullptr);
+}
+
+/* Invalidate the cursor repeatedly, see cursor_blink_timeout_cb(). */
 void
 VteTerminalPrivate::invalidate_cursor_periodic()
 {
 	m_cursor_blink_state = !m_cursor_blink_state;
 	m_cursor_blink_time += m_cursor_blink_cycle;
 
-        m_cursor_blink_tag = 0;
 	invalidate_cursor_once(true);
 
 	/* only disable the blink if the cursor is currently shown.
@@ -730,14 +878,15 @@ VteTerminalPrivate::invalidate_cursor_periodic()
 	 */
 	if (m_cursor_blink_time / 1000 >= m_cursor_blink_timeout &&
 	    m_cursor_blink_state) {
+                g_blinking_terminals = g_list_delete_link(g_blinking_terminals, m_cursor_blink_link);
+                m_cursor_blink_link = nullptr;
 		return;
         }
 
-	m_cursor_blink_tag = g_timeout_add_full(G_PRIORITY_LOW,
-                                                m_cursor_blink_cycle,
-                                                (GSourceFunc)invalidate_cursor_periodic_cb,
-                                                this,
-                                                NULL);
+        /* Stay on the shared boundaries, even if this tick came late */
+        m_cursor_blink_next += m_cursor_blink_cycle * (gint64) 1000;
+        if (m_cursor_blink_next <= g_get_monotonic_time())
+                m_cursor_blink_next = cursor_blink_boundary(g_get_monotonic_time(), m_cursor_blink_cycle);
 }
 
 /* Emit a "selection_changed" signal. */
@@ -2371,6 +2520,7 @@ VteTerminalPrivate::set_color(int entry,
         }
         palette_color->sources[source].is_set = TRUE;
         palette_color->sources[source].color = proposed;
+        update_resolved_color(entry);
 
 	/* If we're not realized yet, there's nothing else to do. */
 	if (!widget_realized())
@@ -2400,6 +2550,7 @@ VteTerminalPrivate::reset_color(int entry,
                 return;
         }
         palette_color->sources[source].is_set = FALSE;
+        update_resolved_color(entry);
 
 	/* If we're not realized yet, there's nothing else to do. */
 	if (!widget_realized())
@@ -2412,6 +2563,32 @@ VteTerminalPrivate::reset_color(int entry,
 		invalidate_all();
 }
 
+/* Recompute the cached result of get_color() for @entry, along with its
+ * dimmed variant. */
+void
+VteTerminalPrivate::update_resolved_color(int entry)
+{
+        VteResolvedColor *resolved = &m_resolved_palette[entry];
+        auto color = get_color(entry);
+
+        resolved->is_set = color != nullptr;
+        if (color == nullptr)
+                return;
+
+        resolved->color = *color;
+        /* magic formula taken from xterm */
+        resolved->dim.red = color->red * 2 / 3;
+        resolved->dim.green = color->green * 2 / 3;
+        resolved->dim.blue = color->blue * 2 / 3;
+}
+
+void
+VteTerminalPrivate::update_resolved_palette()
+{
+        for (int i = 0; i < VTE_PALETTE_SIZE; i++)
+                update_resolved_color(i);
+}
+
 bool
 VteTerminalPrivate::set_background_alpha(double alpha)
 {
@@ -2853,8 +3030,7 @@ VteTerminalPrivate::cursor_down(bool explicit_sequence)
 				/* If we're at the bottom of the scrolling
 				 * region, add a line at the top to scroll the
 				 * bottom off. */
-				ring_remove(start);
-				ring_insert(end, true);
+				ring_rotate(start, end, -1);
 				/* Update the display. */
 				scroll_region(start,
 							   end - start + 1, -1);
@@ -3519,7 +3695,7 @@ VteTerminalPrivate::process_incoming()
 			"Handler processing %" G_GSIZE_FORMAT " bytes over %" G_GSIZE_FORMAT " chunks + %d bytes pending.\n",
 			_vte_incoming_chunks_length(m_incoming),
 			_vte_incoming_chunks_count(m_incoming),
-			m_pending->len);
+			m_pending->len - m_pending_start);
 	_vte_debug_print (VTE_DEBUG_WORK, "(");
 
         auto previous_screen = m_screen;
@@ -3540,11 +3716,11 @@ VteTerminalPrivate::process_incoming()
 
 	/* We should only be called when there's data to process. */
 	g_assert(m_incoming ||
-		 (m_pending->len > 0));
+		 (m_pending->len > m_pending_start));
 
 	/* Convert the data into unicode characters. */
 	unichars = m_pending;
-	for (chunk = _vte_incoming_chunks_reverse (m_incoming);
+	for (chunk = m_incoming;
 			chunk != NULL;
 			chunk = next_chunk) {
 		gsize processed;
@@ -3569,7 +3745,7 @@ VteTerminalPrivate::process_incoming()
 							next_chunk->len);
 					chunk->len += next_chunk->len;
 					chunk->next = next_chunk->next;
-					release_chunk (next_chunk);
+					release_chunk (&m_incoming_arena, next_chunk);
 				} else {
 					/* next few bytes */
 					memcpy (chunk->data + chunk->len,
@@ -3589,25 +3765,30 @@ VteTerminalPrivate::process_incoming()
 skip_chunk:
 			/* cache the last chunk */
 			if (achunk) {
-				release_chunk (achunk);
+				release_chunk (&m_incoming_arena, achunk);
 			}
 			achunk = chunk;
 		}
 	}
 	if (achunk) {
 		if (chunk != NULL) {
-			release_chunk (achunk);
+			release_chunk (&m_incoming_arena, achunk);
 		} else {
 			chunk = achunk;
 			chunk->next = NULL;
 			chunk->len = 0;
 		}
 	}
-	m_incoming = chunk;
+	m_incoming = m_incoming_tail = chunk;
+        if (m_incoming_tail != nullptr) {
+                while (m_incoming_tail->next != nullptr)
+                        m_incoming_tail = m_incoming_tail->next;
+        }
+        m_incoming_arena.buffered = _vte_incoming_chunks_length(m_incoming);
 
 	/* Compute the number of unicode characters we got. */
-	wbuf = &g_array_index(unichars, gunichar, 0);
-	wcount = unichars->len;
+	wbuf = &g_array_index(unichars, gunichar, m_pending_start);
+	wcount = unichars->len - m_pending_start;
 
 	/* Try initial substrings. */
 	start = 0;
@@ -3622,6 +3803,63 @@ skip_chunk:
 		const gunichar *next;
 		GValueArray *params = NULL;
 
+		/* Drop what is left of an overlong string sequence, up to
+		 * and including its terminator. */
+		if (G_UNLIKELY(m_string_discarding)) {
+			while (start < wcount &&
+			       wbuf[start] != 0x07 && wbuf[start] != 0x1b &&
+			       wbuf[start] != 0x9c)
+				start++;
+			if (start == wcount)
+				break;
+			if (wbuf[start] == 0x1b) {
+				if (start + 1 == wcount) {
+					/* Wait to see whether it is ST. */
+					leftovers = TRUE;
+					break;
+				}
+				if (wbuf[start + 1] != '\\') {
+					/* Unterminated; the ESC starts
+					 * something new. */
+					m_string_discarding = false;
+					continue;
+				}
+				start++;
+			}
+			start++;
+			m_string_discarding = false;
+			continue;
+		}
+
+		/* A string sequence left over from the previous batch only
+		 * needs rematching once its terminator has arrived; until
+		 * then just look at the new data, so that payloads split
+		 * over many reads are scanned in linear time. */
+		if (start == 0 && m_string_scanned > 0) {
+			long i;
+
+			for (i = m_string_scanned; i < wcount; i++) {
+				if (wbuf[i] == 0x07 || wbuf[i] == 0x1b ||
+				    wbuf[i] == 0x9c)
+					break;
+			}
+			m_string_scanned = 0;
+			if (i == wcount) {
+				if (wcount > VTE_STRING_SEQUENCE_MAX_LENGTH) {
+					_vte_debug_print(VTE_DEBUG_PARSE,
+							"String sequence too long, "
+							"discarding %ld characters.\n",
+							wcount);
+					m_string_discarding = true;
+					start = wcount;
+				} else {
+					m_string_scanned = wcount;
+					leftovers = TRUE;
+				}
+				break;
+			}
+		}
+
 		/* Try to match any control sequences. */
 		_vte_matcher_match(m_matcher,
 				   &wbuf[start],
@@ -3715,12 +3953,12 @@ skip_chunk:
 					ctrl = *next;
 					/* Move everything before it up a
 					 * slot.  */
-					for (i = next - wbuf; i > start; i--) {
-						wbuf[i] = wbuf[i - 1];
-					}
+					i = next - wbuf;
+					memmove(&wbuf[start + 1], &wbuf[start],
+						(i - start) * sizeof(gunichar));
 					/* Move the control character to the
 					 * front. */
-					wbuf[i] = ctrl;
+					wbuf[start] = ctrl;
 					goto next_match;
 				}
 			}
@@ -3808,6 +4046,23 @@ skip_chunk:
 				/* Pause processing here and wait for more
 				 * data before continuing. */
 				leftovers = TRUE;
+				/* Remember how much of a string sequence's
+				 * payload has been seen, except for the last
+				 * character which may be the ESC of ST. */
+				if (_vte_matcher_is_partial_string(&wbuf[start],
+								   wcount - start)) {
+					if (wcount - start > VTE_STRING_SEQUENCE_MAX_LENGTH) {
+						_vte_debug_print(VTE_DEBUG_PARSE,
+								"String sequence too long, "
+								"discarding %ld characters.\n",
+								wcount - start);
+						m_string_discarding = true;
+						start = wcount;
+						leftovers = FALSE;
+					} else {
+						m_string_scanned = wcount - start - 1;
+					}
+				}
 			}
 		}
 
@@ -3829,11 +4084,25 @@ next_match:
 		}
 	}
 
-	/* Remove most of the processed characters. */
+	/* Remove most of the processed characters.  Only skip over them
+	 * here, and move the unprocessed ones to the front once they are
+	 * outnumbered by the skipped ones, so that each character is copied
+	 * at most once on average. */
 	if (start < wcount) {
-		g_array_remove_range(m_pending, 0, start);
+		m_pending_start += start;
+		if (m_pending_start > m_pending->len - m_pending_start) {
+			g_array_remove_range(m_pending, 0, m_pending_start);
+			m_pending_start = 0;
+		}
 	} else {
-		g_array_set_size(m_pending, 0);
+		/* Don't hold on to the room a long string sequence needed. */
+		if (m_pending->len > VTE_PENDING_SHRINK_LENGTH) {
+			g_array_free(m_pending, TRUE);
+			m_pending = g_array_new(FALSE, TRUE, sizeof(gunichar));
+		} else {
+			g_array_set_size(m_pending, 0);
+		}
+		m_pending_start = 0;
 		/* If we're out of data, we needn't pause to let the
 		 * controlling application respond to incoming data, because
 		 * the main loop is already going to do that. */
@@ -3866,7 +4135,7 @@ next_match:
 		queue_contents_changed();
 	}
 
-	emit_pending_signals();
+	queue_pending_signals();
 
 	if (invalidated_text) {
 		/* Clip off any part of the box which isn't already on-screen. */
@@ -3916,6 +4185,7 @@ next_match:
 			_vte_incoming_chunks_count(m_incoming));
 }
 
+/* Appends @chunks to the end of the incoming queue */
 void
 VteTerminalPrivate::feed_chunks(struct _vte_incoming_chunk *chunks)
 {
@@ -3925,9 +4195,74 @@ VteTerminalPrivate::feed_chunks(struct _vte_incoming_chunk *chunks)
 			_vte_incoming_chunks_length(chunks),
 			_vte_incoming_chunks_count(chunks));
 
+        if (m_incoming_tail != nullptr)
+                m_incoming_tail->next = chunks;
+        else
+                m_incoming = chunks;
 	for (last = chunks; last->next != NULL; last = last->next) ;
-	last->next = m_incoming;
-	m_incoming = chunks;
+        m_incoming_tail = last;
+        m_incoming_arena.buffered += _vte_incoming_chunks_length(chunks);
+}
+
+/* Drops all queued incoming data */
+void
+VteTerminalPrivate::release_incoming()
+{
+	_vte_incoming_chunks_release(&m_incoming_arena, m_incoming);
+        m_incoming = m_incoming_tail = nullptr;
+        m_incoming_arena.buffered = 0;
+}
+
+static gboolean
+idle_trim_timeout(gpointer data)
+{
+        auto that = reinterpret_cast<VteTerminalPrivate*>(data);
+
+        that->m_idle_trim_tag = 0;
+
+        /* Still busy; we'll be scheduled again when going idle */
+        if (that->is_processing() || that->m_incoming_arena.buffered != 0)
+                return G_SOURCE_REMOVE;
+
+        /* The scrollback was read since; wait until it stays unused */
+        if (that->m_normal_screen.row_data->stream_reads != that->m_idle_trim_stream_reads) {
+                that->schedule_idle_trim();
+                return G_SOURCE_REMOVE;
+        }
+
+        /* Let go of the cached empty chunk too, then of the region */
+        that->release_incoming();
+        _vte_incoming_arena_trim(&that->m_incoming_arena);
+
+        /* And of the scrollback's block buffers, until it's accessed again */
+        _vte_ring_trim(that->m_normal_screen.row_data);
+
+        return G_SOURCE_REMOVE;
+}
+
+/* Returns the input arena's and the scrollback streams' memory some time
+ * after the terminal went idle */
+void
+VteTerminalPrivate::schedule_idle_trim()
+{
+        if (m_idle_trim_tag != 0)
+                return;
+
+        m_idle_trim_stream_reads = m_normal_screen.row_data->stream_reads;
+        m_idle_trim_tag = gdk_threads_add_timeout_seconds(VTE_IDLE_TRIM_TIMEOUT,
+                                                          idle_trim_timeout,
+                                                          this);
+}
+
+/* Reading the scrollback while idle allocates the streams' buffers
+ * again, so trim them once more rather than waiting for the child's
+ * next output */
+void
+VteTerminalPrivate::maybe_schedule_idle_trim()
+{
+        if (m_active_terminals_link == nullptr &&
+            m_normal_screen.row_data->stream_reads != m_idle_trim_stream_reads)
+                schedule_idle_trim();
 }
 
 bool
@@ -3944,7 +4279,7 @@ VteTerminalPrivate::pty_io_read(GIOChannel *channel,
 
 	/* Read some data in from this channel. */
 	if (condition & (G_IO_IN | G_IO_PRI)) {
-		struct _vte_incoming_chunk *chunk, *chunks = NULL;
+		struct _vte_incoming_chunk *chunk, *fresh = NULL, *previous_tail = NULL;
 		const int fd = g_io_channel_unix_get_fd (channel);
 		guchar *bp;
 		int rem, len;
@@ -3967,12 +4302,13 @@ VteTerminalPrivate::pty_io_read(GIOChannel *channel,
 		}
 		bytes = m_input_bytes;
 
-		chunk = m_incoming;
+		/* Read straight into the end of the incoming queue */
+		chunk = m_incoming_tail;
 		do {
 			if (!chunk || chunk->len >= 3*sizeof (chunk->data)/4) {
-				chunk = get_chunk ();
-				chunk->next = chunks;
-				chunks = chunk;
+				previous_tail = m_incoming_tail;
+				chunk = fresh = get_chunk (&m_incoming_arena);
+				feed_chunks(chunk);
 			}
 			rem = sizeof (chunk->data) - chunk->len;
 			bp = chunk->data + chunk->len;
@@ -4025,17 +4361,20 @@ VteTerminalPrivate::pty_io_read(GIOChannel *channel,
 			} while (rem);
 out:
 			chunk->len += len;
+			m_incoming_arena.buffered += len;
 			bytes += len;
 		} while (bytes < max_bytes &&
 		         chunk->len == sizeof (chunk->data));
-		if (chunk->len == 0 && chunk == chunks) {
-			chunks = chunks->next;
-			release_chunk (chunk);
+		/* Only the last chunk we added can have stayed empty */
+		if (fresh != NULL && fresh->len == 0) {
+			if (previous_tail != NULL)
+				previous_tail->next = NULL;
+			else
+				m_incoming = NULL;
+			m_incoming_tail = previous_tail;
+			release_chunk (&m_incoming_arena, fresh);
 		}
 
-		if (chunks != NULL) {
-			feed_chunks(chunks);
-		}
 		if (!is_processing()) {
                         G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
 			gdk_threads_enter ();
@@ -4118,11 +4457,11 @@ VteTerminalPrivate::feed(char const* data,
 	/* If we have data, modify the incoming buffer. */
 	if (length > 0) {
 		struct _vte_incoming_chunk *chunk;
-		if (m_incoming &&
-				(gsize)length < sizeof (m_incoming->data) - m_incoming->len) {
-			chunk = m_incoming;
+		if (m_incoming_tail &&
+				(gsize)length < sizeof (m_incoming_tail->data) - m_incoming_tail->len) {
+			chunk = m_incoming_tail;
 		} else {
-			chunk = get_chunk ();
+			chunk = get_chunk (&m_incoming_arena);
 			feed_chunks(chunk);
 		}
 		do { /* break the incoming data into chunks */
@@ -4130,13 +4469,14 @@ VteTerminalPrivate::feed(char const* data,
 			gsize len = (gsize) length < rem ? (gsize) length : rem;
 			memcpy (chunk->data + chunk->len, data, len);
 			chunk->len += len;
+			m_incoming_arena.buffered += len;
 			length -= len;
 			if (length == 0) {
 				break;
 			}
 			data += len;
 
-			chunk = get_chunk ();
+			chunk = get_chunk (&m_incoming_arena);
 			feed_chunks(chunk);
 		} while (1);
 
@@ -4542,25 +4882,27 @@ VteTerminalPrivate::widget_style_updated()
 void
 VteTerminalPrivate::add_cursor_timeout()
 {
-	if (m_cursor_blink_tag)
+	if (m_cursor_blink_link != nullptr)
 		return; /* already added */
 
 	m_cursor_blink_time = 0;
-	m_cursor_blink_tag = g_timeout_add_full(G_PRIORITY_LOW,
-                                                m_cursor_blink_cycle,
-                                                (GSourceFunc)invalidate_cursor_periodic_cb,
-                                                this,
-                                                NULL);
+        m_cursor_blink_next = cursor_blink_boundary(g_get_monotonic_time(), m_cursor_blink_cycle);
+        g_blinking_terminals = g_list_prepend(g_blinking_terminals, this);
+        m_cursor_blink_link = g_blinking_terminals;
+        schedule_cursor_blink_timeout();
 }
 
 void
 VteTerminalPrivate::remove_cursor_timeout()
 {
-	if (m_cursor_blink_tag == 0)
+	if (m_cursor_blink_link == nullptr)
 		return; /* already removed */
 
-	g_source_remove(m_cursor_blink_tag);
-	m_cursor_blink_tag = 0;
+        g_blinking_terminals = g_list_delete_link(g_blinking_terminals, m_cursor_blink_link);
+        m_cursor_blink_link = nullptr;
+        /* The shared timeout notices on its next tick, unless it's idle now */
+        if (g_blinking_terminals == nullptr)
+                schedule_cursor_blink_timeout();
         if (!m_cursor_blink_state) {
                 invalidate_cursor_once();
                 m_cursor_blink_state = true;
@@ -4675,7 +5017,7 @@ VteTerminalPrivate::widget_key_press(GdkEventKey *event)
 		}
 
                 // FIXMEchpe?
-		if (m_cursor_blink_tag != 0) {
+		if (m_cursor_blink_link != nullptr) {
 			remove_cursor_timeout();
 			add_cursor_timeout();
 		}
@@ -5499,6 +5841,8 @@ VteTerminalPrivate::maybe_send_mouse_drag(vte::grid::coords const& unconfined_ro
                                           GdkEventType event_type)
 {
         auto rowcol = confine_grid_coords(unconfined_rowcol);
+        auto previous_rowcol = m_mouse_drag_rowcol;
+        m_mouse_drag_rowcol = rowcol;
 
 	/* First determine if we even want to send notification. */
 	switch (event_type) {
@@ -5515,7 +5859,7 @@ VteTerminalPrivate::maybe_send_mouse_drag(vte::grid::coords const& unconfined_ro
 			 * all-tracking also sends degenerate same-cell events;
                          * we don't.
                          */
-                        if (rowcol == confined_grid_coords_from_view_coords(m_mouse_last_position))
+                        if (rowcol == previous_rowcol)
 				return false;
 		}
 		break;
@@ -5554,23 +5898,27 @@ VteTerminalPrivate::hyperlink_invalidate_and_get_bbox(hyperlink_idx_t idx, GdkRe
         auto first_row = first_displayed_row();
         auto end_row = last_displayed_row() + 1;
         vte::grid::row_t row, top = LONG_MAX, bottom = -1;
-        vte::grid::column_t col, left = LONG_MAX, right = -1;
+        vte::grid::column_t left = LONG_MAX, right = -1;
         const VteRowData *rowdata;
+        const VteHyperlinkSpan *spans;
+        gulong i, n_spans;
 
         g_assert (idx != 0);
 
+        /* Walk the rows' hyperlink span index rather than every cell */
         for (row = first_row; row < end_row; row++) {
                 rowdata = _vte_ring_index(m_screen->row_data, row);
-                if (rowdata != NULL) {
-                        for (col = 0; col < rowdata->len; col++) {
-                                if (G_UNLIKELY (rowdata->cells[col].attr.hyperlink_idx == idx)) {
-                                        invalidate_cells(col, 1, row, 1);
-                                        top = MIN(top, row);
-                                        bottom = MAX(bottom, row);
-                                        left = MIN(left, col);
-                                        right = MAX(right, col);
-                                }
-                        }
+                if (rowdata == NULL)
+                        continue;
+                spans = _vte_row_data_get_hyperlinks(rowdata, &n_spans);
+                for (i = 0; i < n_spans; i++) {
+                        if (spans[i].idx != idx)
+                                continue;
+                        invalidate_cells(spans[i].start, spans[i].end - spans[i].start + 1, row, 1);
+                        top = MIN(top, row);
+                        bottom = MAX(bottom, row);
+                        left = MIN(left, (vte::grid::column_t) spans[i].start);
+                        right = MAX(right, (vte::grid::column_t) spans[i].end);
                 }
         }
 
@@ -5680,13 +6028,22 @@ VteTerminalPrivate::hyperlink_hilite(vte::view::coords const& pos)
          * need do nothing. Note: Don't use mouse_last_row as that's relative
          * to insert_delta, and we care about the absolute row number. */
         if (grid_coords_from_view_coords(pos) ==
-             confined_grid_coords_from_view_coords(m_mouse_last_position)) {
+             confined_grid_coords_from_view_coords(m_mouse_hilite_position)) {
                 return;
         }
 
        hyperlink_hilite_update(pos);
 }
 
+/* Updates the hyperlink and match hilites for the pointer being at @pos. */
+void
+VteTerminalPrivate::hilite_hover(vte::view::coords const& pos)
+{
+        hyperlink_hilite(pos);
+        match_hilite(pos);
+        m_mouse_hilite_position = pos;
+}
+
 /*
  * VteTerminalPrivate::match_hilite_clear:
  *
@@ -5839,7 +6196,7 @@ VteTerminalPrivate::match_hilite(vte::view::coords const& pos)
 	 * need do nothing. Note: Don't use mouse_last_row as that's relative
 	 * to insert_delta, and we care about the absolute row number. */
 	if (grid_coords_from_view_coords(pos) ==
-            confined_grid_coords_from_view_coords(m_mouse_last_position) ||
+            confined_grid_coords_from_view_coords(m_mouse_hilite_position) ||
             cursor_inside_match(pos)) {
 		m_show_match = m_match != nullptr;
 		return;
@@ -5950,51 +6307,69 @@ void
 VteTerminalPrivate::rgb_from_index(guint index,
                                    vte::color::rgb& color) const
 {
-        bool dim = false;
-        if (!(index & VTE_RGB_COLOR) && (index & VTE_DIM_COLOR)) {
-                index &= ~VTE_DIM_COLOR;
-                dim = true;
-        }
-
-	if (index >= VTE_LEGACY_COLORS_OFFSET && index < VTE_LEGACY_COLORS_OFFSET + VTE_LEGACY_FULL_COLOR_SET_SIZE)
-		index -= VTE_LEGACY_COLORS_OFFSET;
-	if (index < VTE_PALETTE_SIZE) {
-                color = *get_color(index);
-                if (dim) {
-                        /* magic formula taken from xterm */
-                        color.red = color.red * 2 / 3;
-                        color.green = color.green * 2 / 3;
-                        color.blue = color.blue * 2 / 3;
-                }
-	} else if (index & VTE_RGB_COLOR) {
+	if (index & VTE_RGB_COLOR) {
 		color.red = ((index >> 16) & 0xFF) * 257;
 		color.green = ((index >> 8) & 0xFF) * 257;
 		color.blue = (index & 0xFF) * 257;
-	} else {
-		g_assert_not_reached();
+		return;
 	}
+
+        bool dim = (index & VTE_DIM_COLOR) != 0;
+        index &= ~VTE_DIM_COLOR;
+
+	if (index >= VTE_LEGACY_COLORS_OFFSET && index < VTE_LEGACY_COLORS_OFFSET + VTE_LEGACY_FULL_COLOR_SET_SIZE)
+		index -= VTE_LEGACY_COLORS_OFFSET;
+	g_assert(index < VTE_PALETTE_SIZE);
+
+        /* See update_resolved_color() */
+        VteResolvedColor const* resolved = &m_resolved_palette[index];
+        color = dim ? resolved->dim : resolved->color;
+}
+
+static guint
+text_attribute_flags(VteCellAttr const* attr)
+{
+        return (attr->bold ? VTE_TEXT_ATTRIBUTE_BOLD : 0) |
+                (attr->italic ? VTE_TEXT_ATTRIBUTE_ITALIC : 0) |
+                (attr->underline ? VTE_TEXT_ATTRIBUTE_UNDERLINE : 0) |
+                (attr->strikethrough ? VTE_TEXT_ATTRIBUTE_STRIKETHROUGH : 0) |
+                (attr->reverse ? VTE_TEXT_ATTRIBUTE_REVERSE : 0) |
+                (attr->blink ? VTE_TEXT_ATTRIBUTE_BLINK : 0) |
+                (attr->dim ? VTE_TEXT_ATTRIBUTE_DIM : 0) |
+                (attr->invisible ? VTE_TEXT_ATTRIBUTE_INVISIBLE : 0) |
+                (attr->hyperlink_idx != 0 ? VTE_TEXT_ATTRIBUTE_HYPERLINK : 0);
 }
 
+/*
+ * VteTerminalPrivate::get_text_runs:
+ *
+ * Extracts the text between the given positions, together with one
+ * #VteTextAttributeRun for each stretch of cells of a row sharing the same
+ * rendition.  A run is also started whenever the width of the characters
+ * changes, so that every character's column can be recovered from the run.
+ * The hyperlink targets are not looked up here, see get_text_run_hyperlinks().
+ */
 GString*
-VteTerminalPrivate::get_text(vte::grid::row_t start_row,
-                             vte::grid::column_t start_col,
-                             vte::grid::row_t end_row,
-                             vte::grid::column_t end_col,
-                             bool block,
-                             bool wrap,
-                             bool include_trailing_spaces,
-                             GArray *attributes)
+VteTerminalPrivate::get_text_runs(vte::grid::row_t start_row,
+                                  vte::grid::column_t start_col,
+                                  vte::grid::row_t end_row,
+                                  vte::grid::column_t end_col,
+                                  bool block,
+                                  bool wrap,
+                                  bool include_trailing_spaces,
+                                  GArray *runs)
 {
 	const VteCell *pcell = NULL;
 	GString *string;
-	struct _VteCharAttributes attr;
+	VteTextAttributeRun run, *last_run;
+	VteCellAttr const* run_attr;
 	vte::color::rgb fore, back;
 
-	if (attributes)
-		g_array_set_size (attributes, 0);
+	if (runs)
+		g_array_set_size (runs, 0);
 
 	string = g_string_new(NULL);
-	memset(&attr, 0, sizeof(attr));
+	memset(&run, 0, sizeof(run));
 
         if (start_col < 0)
                 start_col = 0;
@@ -6007,34 +6382,54 @@ VteTerminalPrivate::get_text(vte::grid::row_t start_row,
                 gsize last_empty, last_nonempty;
                 vte::grid::column_t last_emptycol, last_nonemptycol;
                 vte::grid::column_t line_last_column = (block || row == end_row) ? end_col : G_MAXLONG;
+                vte::grid::column_t last_column = col;
 
 		last_empty = last_nonempty = string->len;
 		last_emptycol = last_nonemptycol = -1;
 
-		attr.row = row;
-		attr.column = col;
+		run.row = row;
+		run_attr = NULL;
 		pcell = NULL;
 		if (row_data != NULL) {
                         while (col <= line_last_column &&
                                (pcell = _vte_row_data_get (row_data, col))) {
 
-				attr.column = col;
+				last_column = col;
 
 				/* If it's not part of a multi-column character,
 				 * and passes the selection criterion, add it to
 				 * the selection. */
 				if (!pcell->attr.fragment) {
-					/* Store the attributes of this character. */
-					rgb_from_index(pcell->attr.fore, fore);
-					rgb_from_index(pcell->attr.back, back);
-					attr.fore.red = fore.red;
-					attr.fore.green = fore.green;
-					attr.fore.blue = fore.blue;
-					attr.back.red = back.red;
-					attr.back.green = back.green;
-					attr.back.blue = back.blue;
-					attr.underline = pcell->attr.underline;
-					attr.strikethrough = pcell->attr.strikethrough;
+					VteCellAttr const* attr = &pcell->attr;
+
+					/* Start a new run if the rendition or the
+					 * width changes.  A lone zero-width character
+					 * (only ever seen at the start of a thawed row)
+					 * gets its own run, too. */
+					if (runs &&
+					    (run_attr == NULL ||
+					     attr->fore != run_attr->fore ||
+					     attr->back != run_attr->back ||
+					     attr->columns != run_attr->columns ||
+					     attr->hyperlink_idx != run_attr->hyperlink_idx ||
+					     text_attribute_flags(attr) != run.flags ||
+					     G_UNLIKELY (pcell->c >= 0x80 &&
+							 g_unichar_iszerowidth(_vte_unistr_get_base(pcell->c))))) {
+						rgb_from_index(attr->fore, fore);
+						rgb_from_index(attr->back, back);
+						run.fore.red = fore.red;
+						run.fore.green = fore.green;
+						run.fore.blue = fore.blue;
+						run.back.red = back.red;
+						run.back.green = back.green;
+						run.back.blue = back.blue;
+						run.flags = text_attribute_flags(attr);
+						run.width = attr->columns;
+						run.start = run.end = string->len;
+						run.column = col;
+						g_array_append_val(runs, run);
+						run_attr = attr;
+					}
 
 					/* Store the cell string */
 					if (pcell->c == 0) {
@@ -6047,12 +6442,8 @@ VteTerminalPrivate::get_text(vte::grid::row_t start_row,
 						last_nonemptycol = col;
 					}
 
-					/* If we added text to the string, record its
-					 * attributes, one per byte. */
-					if (attributes) {
-						vte_g_array_fill(attributes,
-								&attr, string->len);
-					}
+					if (runs)
+						g_array_index(runs, VteTextAttributeRun, runs->len - 1).end = string->len;
 				}
 
 				col++;
@@ -6079,39 +6470,133 @@ VteTerminalPrivate::get_text(vte::grid::row_t start_row,
 			}
 			if (pcell == NULL) {
 				g_string_truncate(string, last_nonempty);
-				if (attributes)
-					g_array_set_size(attributes, string->len);
-				attr.column = last_nonemptycol;
+				while (runs && runs->len > 0) {
+					last_run = &g_array_index(runs, VteTextAttributeRun, runs->len - 1);
+					if (last_run->start < string->len) {
+						last_run->end = MIN(last_run->end, string->len);
+						break;
+					}
+					g_array_set_size(runs, runs->len - 1);
+				}
+				last_column = last_nonemptycol;
 			}
 		}
 
-		/* Adjust column, in case we want to append a newline */
-                //FIXMEchpe MIN ?
-		attr.column = MAX(m_column_count, attr.column + 1);
-
-		/* Add a newline in block mode. */
-		if (block) {
+		/* Add a newline in block mode, or else if the last visible
+		 * column on this line was in range and not soft-wrapped. */
+		/* XXX need to clear row->soft_wrap on deletion! */
+		if (block || (row < end_row && !line_is_wrappable(row))) {
 			string = g_string_append_c(string, '\n');
-		}
-		/* Else, if the last visible column on this line was in range and
-		 * not soft-wrapped, append a newline. */
-		else if (row < end_row) {
-			/* If we didn't softwrap, add a newline. */
-			/* XXX need to clear row->soft_wrap on deletion! */
-			if (!line_is_wrappable(row)) {
-				string = g_string_append_c(string, '\n');
-			}
-		}
 
-		/* Make sure that the attributes array is as long as the string. */
-		if (attributes) {
-			vte_g_array_fill (attributes, &attr, string->len);
+			/* The newline keeps the rendition of the character
+			 * before it. */
+			if (runs) {
+				//FIXMEchpe MIN ?
+				run.column = MAX(m_column_count, last_column + 1);
+				run.width = 0;
+				run.start = string->len - 1;
+				run.end = string->len;
+				g_array_append_val(runs, run);
+			}
 		}
 	}
 
+        maybe_schedule_idle_trim();
+
+        return string;
+}
+
+/*
+ * VteTerminalPrivate::get_text_run_hyperlinks:
+ *
+ * Fills in the targets of the hyperlinked runs returned by get_text_runs().
+ * This is done as a separate pass since looking up a target may thaw its row
+ * from the streams, clobbering the ring's cached row.
+ */
+void
+VteTerminalPrivate::get_text_run_hyperlinks(GArray *runs)
+{
+        const char *hyperlink, *separator;
+
+        if (!m_allow_hyperlink)
+                return;
+
+        for (guint i = 0; i < runs->len; i++) {
+                auto run = &g_array_index(runs, VteTextAttributeRun, i);
+                if (!(run->flags & VTE_TEXT_ATTRIBUTE_HYPERLINK) || run->width == 0)
+                        continue;
+
+                _vte_ring_get_hyperlink_at_position(m_screen->row_data, run->row, run->column,
+                                                    false, &hyperlink);
+                if (hyperlink == NULL)
+                        continue;
+
+                /* URI is after the first semicolon */
+                separator = strchr(hyperlink, ';');
+                g_assert(separator != NULL);
+                run->hyperlink = g_strdup(separator + 1);
+        }
+}
+
+/* Expands attribute runs into one VteCharAttributes per byte of the text. */
+static void
+vte_char_attributes_from_runs(GString const* text,
+                              GArray const* runs,
+                              GArray *attributes)
+{
+        struct _VteCharAttributes attr;
+
+        memset(&attr, 0, sizeof(attr));
+        g_array_set_size(attributes, 0);
+
+        for (guint i = 0; i < runs->len; i++) {
+                auto run = &g_array_index(runs, VteTextAttributeRun, i);
+                char const* p = text->str + run->start;
+                char const* end = text->str + run->end;
+
+                attr.row = run->row;
+                attr.column = run->column;
+                attr.fore = run->fore;
+                attr.back = run->back;
+                attr.underline = (run->flags & VTE_TEXT_ATTRIBUTE_UNDERLINE) != 0;
+                attr.strikethrough = (run->flags & VTE_TEXT_ATTRIBUTE_STRIKETHROUGH) != 0;
+
+                for (bool first = true; p < end; first = false) {
+                        char const* q = g_utf8_next_char(p);
+
+                        /* Combining marks share the column of their base */
+                        if (!first && ((guchar)*p < 0x80 || !g_unichar_iszerowidth(g_utf8_get_char(p))))
+                                attr.column += run->width;
+                        vte_g_array_fill(attributes, &attr, q - text->str);
+                        p = q;
+                }
+        }
+}
+
+GString*
+VteTerminalPrivate::get_text(vte::grid::row_t start_row,
+                             vte::grid::column_t start_col,
+                             vte::grid::row_t end_row,
+                             vte::grid::column_t end_col,
+                             bool block,
+                             bool wrap,
+                             bool include_trailing_spaces,
+                             GArray *attributes)
+{
+        if (attributes == nullptr)
+                return get_text_runs(start_row, start_col, end_row, end_col,
+                                     block, wrap, include_trailing_spaces,
+                                     nullptr);
+
+        GArray *runs = g_array_new(FALSE, FALSE, sizeof(VteTextAttributeRun));
+        GString *string = get_text_runs(start_row, start_col, end_row, end_col,
+                                        block, wrap, include_trailing_spaces,
+                                        runs);
+        vte_char_attributes_from_runs(string, runs, attributes);
+        g_array_free(runs, TRUE);
+
 	/* Sanity check. */
-        if (attributes != nullptr)
-                g_assert_cmpuint(string->len, ==, attributes->len);
+        g_assert_cmpuint(string->len, ==, attributes->len);
 
         return string;
 }
@@ -7108,6 +7593,53 @@ VteTerminalPrivate::stop_autoscroll()
         m_mouse_autoscroll_tag = 0;
 }
 
+static gboolean
+motion_tick_cb(GtkWidget *widget,
+               GdkFrameClock *frame_clock,
+               gpointer data)
+{
+        auto that = reinterpret_cast<VteTerminalPrivate*>(data);
+
+        that->m_motion_tick_id = 0;
+        that->flush_motion();
+
+        return G_SOURCE_REMOVE;
+}
+
+/* Pointers can report motion much more often than we draw frames, and
+ * hiliting matches or reporting the motion to the child is costly, so that
+ * is done once per frame for the latest position; see flush_motion(). */
+void
+VteTerminalPrivate::queue_motion()
+{
+        if (m_motion_tick_id != 0)
+                return;
+
+        m_motion_tick_id = gtk_widget_add_tick_callback(m_widget, motion_tick_cb, this, nullptr);
+}
+
+/* Handles the motion queued since the last frame.  Called before handling
+ * any other pointer event, so the child sees the events in order. */
+void
+VteTerminalPrivate::flush_motion()
+{
+        if (m_motion_tick_id != 0) {
+                gtk_widget_remove_tick_callback(m_widget, m_motion_tick_id);
+                m_motion_tick_id = 0;
+        }
+
+        if (m_motion_hilite_pending) {
+                m_motion_hilite_pending = false;
+                hilite_hover(m_mouse_last_position);
+        }
+        if (m_motion_drag_pending) {
+                m_motion_drag_pending = false;
+                if (m_input_enabled)
+                        maybe_send_mouse_drag(grid_coords_from_view_coords(m_mouse_last_position),
+                                              GDK_MOTION_NOTIFY);
+        }
+}
+
 bool
 VteTerminalPrivate::widget_motion_notify(GdkEventMotion *event)
 {
@@ -7124,11 +7656,12 @@ VteTerminalPrivate::widget_motion_notify(GdkEventMotion *event)
 	read_modifiers(base_event);
 
         if (m_mouse_pressed_buttons != 0) {
+                m_motion_hilite_pending = false;
 		match_hilite_hide();
 	} else if (pos != m_mouse_last_position) {
-		/* Hilite any matches. */
-                hyperlink_hilite(pos);
-		match_hilite(pos);
+		/* Hilite any matches, once per frame. */
+                m_motion_hilite_pending = true;
+                queue_motion();
 		/* Show the cursor. */
                 set_pointer_autohidden(false);
 	}
@@ -7165,8 +7698,13 @@ VteTerminalPrivate::widget_motion_notify(GdkEventMotion *event)
 			handled = true;
 		}
 
-		if (!handled && m_input_enabled)
-			maybe_send_mouse_drag(rowcol, event->type);
+		if (!handled && m_input_enabled) {
+                        /* Report the motion once per frame, see flush_motion() */
+                        m_motion_drag_pending = true;
+                        queue_motion();
+                } else if (handled) {
+                        m_mouse_drag_rowcol = confine_grid_coords(rowcol);
+                }
 		break;
 	default:
 		break;
@@ -7188,8 +7726,8 @@ VteTerminalPrivate::widget_button_press(GdkEventButton *event)
         auto pos = view_coords_from_event(base_event);
         auto rowcol = grid_coords_from_view_coords(pos);
 
-        hyperlink_hilite(pos);
-	match_hilite(pos);
+        flush_motion();
+        hilite_hover(pos);
 
         set_pointer_autohidden(false);
 
@@ -7326,6 +7864,7 @@ VteTerminalPrivate::widget_button_press(GdkEventButton *event)
         if (event->button >= 1 && event->button <= 3)
                 m_mouse_pressed_buttons |= (1 << (event->button - 1));
 	m_mouse_last_position = pos;
+        m_mouse_drag_rowcol = confine_grid_coords(rowcol);
 
 	return handled;
 }
@@ -7339,8 +7878,8 @@ VteTerminalPrivate::widget_button_release(GdkEventButton *event)
         auto pos = view_coords_from_event(base_event);
         auto rowcol = grid_coords_from_view_coords(pos);
 
-        hyperlink_hilite(pos);
-	match_hilite(pos);
+        flush_motion();
+        hilite_hover(pos);
 
         set_pointer_autohidden(false);
 
@@ -7378,6 +7917,7 @@ VteTerminalPrivate::widget_button_release(GdkEventButton *event)
         if (event->button >= 1 && event->button <= 3)
                 m_mouse_pressed_buttons &= ~(1 << (event->button - 1));
 	m_mouse_last_position = pos;
+        m_mouse_drag_rowcol = confine_grid_coords(rowcol);
 	m_selecting_after_threshold = false;
 
 	return handled;
@@ -7456,6 +7996,7 @@ VteTerminalPrivate::widget_leave(GdkEventCrossing *event)
 
 	_vte_debug_print(VTE_DEBUG_EVENTS, "Leave at %s\n", pos.to_string());
 
+        flush_motion();
         match_hilite_hide();
 
         /* Mark the cursor as invisible to disable hilite updating,
@@ -7492,7 +8033,8 @@ VteTerminalPrivate::widget_visibility_notify(GdkEventVisibility *event)
 	}
 
 	/* fully obscured to visible switch, force the fast path */
-	if (m_visibility_state == GDK_VISIBILITY_FULLY_OBSCURED) {
+	if (m_visibility_state == GDK_VISIBILITY_FULLY_OBSCURED &&
+            !m_rendering_suspended) {
 		/* set invalidated_all false, since we didn't really mean it
 		 * when we set it to TRUE when becoming obscured */
 		m_invalidated_all = FALSE;
@@ -7846,17 +8388,39 @@ VteTerminalPrivate::screen_set_size(VteScreen *screen_,
 void
 VteTerminalPrivate::set_size(long columns,
                              long rows)
+{
+        /* An explicit size overrides an interactive resize still settling */
+        if (m_resize_settle_tag != 0) {
+                g_source_remove(m_resize_settle_tag);
+                m_resize_settle_tag = 0;
+        }
+
+        apply_size(columns, rows, false);
+}
+
+/* Changes the size of the screens and of the PTY.  While @settling, that is
+ * while the user is still dragging the window edge, the normal screen is
+ * not rewrapped and the child is told about the new size at most once per
+ * frame; finish_resize() catches up on both once the size stops changing.
+ * Returns whether anything changed. */
+bool
+VteTerminalPrivate::apply_size(long columns,
+                               long rows,
+                               bool settling)
 {
 	glong old_columns, old_rows;
+        bool rewrap;
 
 	_vte_debug_print(VTE_DEBUG_RESIZE,
-			"Setting PTY size to %ldx%ld.\n",
-			columns, rows);
+			"Setting PTY size to %ldx%ld%s.\n",
+			columns, rows, settling ? " (settling)" : "");
 
 	old_rows = m_row_count;
 	old_columns = m_column_count;
 
-	if (m_pty != NULL) {
+	if (m_pty != NULL &&
+            (!settling ||
+             g_get_monotonic_time() - m_last_winsize_time >= VTE_RESIZE_WINSIZE_INTERVAL * 1000)) {
                 GError *error = NULL;
 
 		/* Try to set the terminal size, and read it back,
@@ -7866,37 +8430,84 @@ VteTerminalPrivate::set_size(long columns,
 			g_warning("%s\n", error->message);
                         g_error_free(error);
 		}
+                m_last_winsize_time = g_get_monotonic_time();
+                m_winsize_pending = false;
 		refresh_size();
 	} else {
 		m_row_count = rows;
 		m_column_count = columns;
+                m_winsize_pending = m_pty != NULL;
 	}
-	if (old_rows != m_row_count || old_columns != m_column_count) {
-                m_scrolling_restricted = FALSE;
 
-                _vte_ring_set_visible_rows(m_normal_screen.row_data, m_row_count);
-                _vte_ring_set_visible_rows(m_alternate_screen.row_data, m_row_count);
+        /* Rewrapping is the expensive part with a long scrollback, so only
+         * do it once the size has settled, straight to the final width. */
+        rewrap = !settling && m_rewrap_on_resize &&
+                m_rewrapped_column_count != m_column_count;
 
-		/* Resize the normal screen and (if rewrapping is enabled) rewrap it even if the alternate screen is visible: bug 415277 */
-		screen_set_size(&m_normal_screen, old_columns, old_rows, m_rewrap_on_resize);
-		/* Resize the alternate screen if it's the current one, but never rewrap it: bug 336238 comment 60 */
-		if (m_screen == &m_alternate_screen)
-			screen_set_size(&m_alternate_screen, old_columns, old_rows, false);
+	if (old_rows == m_row_count && old_columns == m_column_count && !rewrap) {
+                if (!settling)
+                        m_rewrapped_column_count = m_column_count;
+                return false;
+        }
 
-                /* Ensure scrollback buffers cover the screen. */
-                set_scrollback_lines(m_scrollback_lines);
+        m_scrolling_restricted = FALSE;
 
-                /* Ensure the cursor is valid */
-                m_screen->cursor.row = CLAMP (m_screen->cursor.row,
-                                              _vte_ring_delta (m_screen->row_data),
-                                              MAX (_vte_ring_delta (m_screen->row_data),
-                                                   _vte_ring_next (m_screen->row_data) - 1));
+        _vte_ring_set_visible_rows(m_normal_screen.row_data, m_row_count);
+        _vte_ring_set_visible_rows(m_alternate_screen.row_data, m_row_count);
 
-		adjust_adjustments_full();
-		gtk_widget_queue_resize_no_redraw(m_widget);
-		/* Our visible text changed. */
-		emit_text_modified();
-	}
+        /* Resize the normal screen and (if rewrapping is enabled) rewrap it even if the alternate screen is visible: bug 415277 */
+        screen_set_size(&m_normal_screen, m_rewrapped_column_count, old_rows, rewrap);
+        if (!settling)
+                m_rewrapped_column_count = m_column_count;
+        /* Resize the alternate screen if it's the current one, but never rewrap it: bug 336238 comment 60 */
+        if (m_screen == &m_alternate_screen)
+                screen_set_size(&m_alternate_screen, old_columns, old_rows, false);
+
+        /* Ensure scrollback buffers cover the screen. */
+        set_scrollback_lines(m_scrollback_lines);
+
+        /* Ensure the cursor is valid */
+        m_screen->cursor.row = CLAMP (m_screen->cursor.row,
+                                      _vte_ring_delta (m_screen->row_data),
+                                      MAX (_vte_ring_delta (m_screen->row_data),
+                                           _vte_ring_next (m_screen->row_data) - 1));
+
+        adjust_adjustments_full();
+        gtk_widget_queue_resize_no_redraw(m_widget);
+        /* Our visible text changed. */
+        emit_text_modified();
+
+        return true;
+}
+
+static gboolean
+resize_settle_timeout_cb(VteTerminalPrivate *that)
+{
+        that->m_resize_settle_tag = 0;
+        that->finish_resize();
+
+        return G_SOURCE_REMOVE;
+}
+
+/* Ends an interactive resize: rewraps the normal screen to the final width
+ * and sends the final window size to the child if that is still due. */
+void
+VteTerminalPrivate::finish_resize()
+{
+        if (m_resize_settle_tag != 0) {
+                g_source_remove(m_resize_settle_tag);
+                m_resize_settle_tag = 0;
+        }
+
+        if (!m_winsize_pending && m_rewrapped_column_count == m_column_count)
+                return;
+
+        _vte_debug_print(VTE_DEBUG_RESIZE, "Interactive resize settled.\n");
+
+        if (apply_size(m_column_count, m_row_count, false)) {
+                queue_contents_changed();
+                invalidate_all();
+        }
 }
 
 /* Redraw the widget. */
@@ -7917,7 +8528,7 @@ VteTerminalPrivate::vadjustment_value_changed()
 	/* Sanity checks. */
         if (G_UNLIKELY(!widget_realized()))
                 return;
-	if (m_visibility_state == GDK_VISIBILITY_FULLY_OBSCURED)
+	if (rendering_inhibited())
 		return;
 
         /* FIXME: do this check in pixel space */
@@ -8001,6 +8612,15 @@ VteTerminalPrivate::VteTerminalPrivate(VteTerminal *t) :
                                            FALSE /* clear */,
                                            sizeof(cairo_rectangle_int_t),
                                            32 /* preallocated size */);
+        m_draw_runs = g_array_new(FALSE /* zero terminated */,
+                                  FALSE /* clear */,
+                                  sizeof(struct vte_draw_run));
+        m_draw_fill_rects = g_array_new(FALSE /* zero terminated */,
+                                        FALSE /* clear */,
+                                        sizeof(struct vte_draw_fill_rect));
+        m_draw_batch_fills = false;
+        memset(&m_draw_timings, 0, sizeof(m_draw_timings));
+        m_draw_timings_enabled = false;
 
 	/* Set an adjustment for the application to use to control scrolling. */
         m_vadjustment = nullptr;
@@ -8024,6 +8644,18 @@ VteTerminalPrivate::VteTerminalPrivate(VteTerminal *t) :
 
         m_row_count = VTE_ROWS;
         m_column_count = VTE_COLUMNS;
+        m_rewrapped_column_count = m_column_count;
+        m_last_resize_time = 0;
+        m_last_winsize_time = 0;
+        m_resize_settle_tag = 0;
+        m_winsize_pending = false;
+        m_last_signals_time = 0;
+        m_pending_signals_tag = 0;
+        m_motion_tick_id = 0;
+        m_motion_hilite_pending = false;
+        m_motion_drag_pending = false;
+        m_mouse_hilite_position = vte::view::coords(-1, -1);
+        m_mouse_drag_rowcol = vte::grid::coords(-1, -1);
 
 	/* Initialize the screens and histories. */
 	_vte_ring_init (m_alternate_screen.row_data, m_row_count, FALSE);
@@ -8042,14 +8674,27 @@ VteTerminalPrivate::VteTerminalPrivate(VteTerminal *t) :
 	set_colors_default();
 	for (i = 0; i < VTE_PALETTE_SIZE; i++)
 		m_palette[i].sources[VTE_COLOR_SOURCE_ESCAPE].is_set = FALSE;
+        update_resolved_palette();
 
 	/* Set up I/O encodings. */
         m_utf8_ambiguous_width = VTE_DEFAULT_UTF8_AMBIGUOUS_WIDTH;
         m_iso2022 = _vte_iso2022_state_new(m_encoding);
-	m_incoming = nullptr;
+	m_incoming = m_incoming_tail = nullptr;
+        memset(&m_incoming_arena, 0, sizeof(m_incoming_arena));
+        m_idle_trim_tag = 0;
+        m_idle_trim_stream_reads = 0;
 	m_pending = g_array_new(FALSE, TRUE, sizeof(gunichar));
+        m_pending_start = 0;
+        m_string_scanned = 0;
+        m_string_discarding = false;
 	m_max_input_bytes = VTE_MAX_INPUT_READ;
-	m_cursor_blink_tag = 0;
+        m_process_time_target = VTE_MAX_PROCESS_TIME;
+        for (auto& rate : m_process_rate)
+                rate = 0.;
+        m_process_class = VTE_CONTENT_CLASS_TEXT;
+        m_process_last_time = 0.;
+	m_cursor_blink_link = nullptr;
+        m_cursor_blink_next = 0;
 	m_outgoing = _vte_byte_array_new();
 	m_outgoing_conv = VTE_INVALID_CONV;
 	m_conv_buffer = _vte_byte_array_new();
@@ -8150,6 +8795,9 @@ VteTerminalPrivate::VteTerminalPrivate(VteTerminal *t) :
 	/* Not all backends generate GdkVisibilityNotify, so mark the
 	 * window as unobscured initially. */
 	m_visibility_state = GDK_VISIBILITY_UNOBSCURED;
+        m_rendering_suspended = false;
+        m_max_frame_rate = 0;
+        m_last_frame_time = 0;
 
         m_padding = default_padding;
         update_view_extents();
@@ -8263,8 +8911,25 @@ VteTerminalPrivate::widget_size_allocate(GtkAllocation *allocation)
 			|| height != m_row_count
 			|| update_scrollback)
 	{
+                /* Allocations following each other closely mean the user is
+                 * dragging the window edge; coalesce those until it settles. */
+                gint64 now = g_get_monotonic_time();
+                bool settling = m_resize_settle_tag != 0 ||
+                        now - m_last_resize_time < VTE_RESIZE_SETTLE_TIMEOUT * 1000;
+                m_last_resize_time = now;
+
 		/* Set the size of the pseudo-terminal. */
-		set_size(width, height);
+                if (settling) {
+                        apply_size(width, height, true);
+
+                        if (m_resize_settle_tag != 0)
+                                g_source_remove(m_resize_settle_tag);
+                        m_resize_settle_tag = gdk_threads_add_timeout(VTE_RESIZE_SETTLE_TIMEOUT,
+                                                                      (GSourceFunc) resize_settle_timeout_cb,
+                                                                      this);
+                } else {
+                        set_size(width, height);
+                }
 
 		/* Notify viewers that the contents have changed. */
 		queue_contents_changed();
@@ -8290,6 +8955,13 @@ VteTerminalPrivate::widget_unrealize()
 {
 	_vte_debug_print(VTE_DEBUG_LIFECYCLE, "vte_terminal_unrealize()\n");
 
+        /* Drop any motion not handled yet */
+        if (m_motion_tick_id != 0) {
+                gtk_widget_remove_tick_callback(m_widget, m_motion_tick_id);
+                m_motion_tick_id = 0;
+        }
+        m_motion_hilite_pending = m_motion_drag_pending = false;
+
 	/* Deallocate the cursors. */
         m_mouse_cursor_over_widget = FALSE;
 	g_object_unref(m_mouse_default_cursor);
@@ -8515,8 +9187,21 @@ VteTerminalPrivate::~VteTerminalPrivate()
 	/* Stop processing input. */
 	stop_processing(this);
 
+        /* Normally done on unrealize already */
+        if (m_cursor_blink_link != nullptr) {
+                g_blinking_terminals = g_list_delete_link(g_blinking_terminals, m_cursor_blink_link);
+                m_cursor_blink_link = nullptr;
+        }
+
 	/* Discard any pending data. */
-	_vte_incoming_chunks_release(m_incoming);
+	release_incoming();
+        if (m_idle_trim_tag != 0)
+                g_source_remove(m_idle_trim_tag);
+        if (m_resize_settle_tag != 0)
+                g_source_remove(m_resize_settle_tag);
+        if (m_pending_signals_tag != 0)
+                g_source_remove(m_pending_signals_tag);
+        _vte_incoming_arena_trim(&m_incoming_arena);
 	_vte_byte_array_free(m_outgoing);
 	g_array_free(m_pending, TRUE);
 	_vte_byte_array_free(m_conv_buffer);
@@ -8582,6 +9267,9 @@ VteTerminalPrivate::~VteTerminalPrivate()
 
         /* Update rects */
         g_array_free(m_update_rects, TRUE /* free segment */);
+
+        g_array_free(m_draw_runs, TRUE /* free segment */);
+        g_array_free(m_draw_fill_rects, TRUE /* free segment */);
 }
 
 void
@@ -8743,11 +9431,11 @@ VteTerminalPrivate::determine_colors(VteCellAttr const* attr,
 	if (is_selected) {
 		/* XXX what if hightlight back is same color as current back? */
 		bool do_swap = true;
-		if (get_color(VTE_HIGHLIGHT_BG) != NULL) {
+		if (m_resolved_palette[VTE_HIGHLIGHT_BG].is_set) {
 			back = VTE_HIGHLIGHT_BG;
 			do_swap = false;
 		}
-		if (get_color(VTE_HIGHLIGHT_FG) != NULL) {
+		if (m_resolved_palette[VTE_HIGHLIGHT_FG].is_set) {
 			fore = VTE_HIGHLIGHT_FG;
 			do_swap = false;
 		}
@@ -8759,11 +9447,11 @@ VteTerminalPrivate::determine_colors(VteCellAttr const* attr,
 	if (is_cursor) {
 		/* XXX what if cursor back is same color as current back? */
                 bool do_swap = true;
-                if (get_color(VTE_CURSOR_BG) != NULL) {
+                if (m_resolved_palette[VTE_CURSOR_BG].is_set) {
                         back = VTE_CURSOR_BG;
                         do_swap = false;
                 }
-                if (get_color(VTE_CURSOR_FG) != NULL) {
+                if (m_resolved_palette[VTE_CURSOR_FG].is_set) {
                         fore = VTE_CURSOR_FG;
                         do_swap = false;
                 }
@@ -8802,6 +9490,120 @@ VteTerminalPrivate::determine_cursor_colors(VteCell const* cell,
                          fore, back);
 }
 
+/* Fills a rectangle with the color @color (see determine_colors()).  While
+ * m_draw_batch_fills is set the rectangle is only queued, and all queued
+ * rectangles of the same color are later filled at once by
+ * flush_fill_rectangles().
+ *
+ * Rectangles must be queued row by row and must not reach beyond their
+ * row vertically.  If one overlaps a queued rectangle of another color,
+ * the queue is flushed first, so it still paints over the earlier ones. */
+void
+VteTerminalPrivate::queue_fill_rectangle(guint color,
+                                         int x,
+                                         int y,
+                                         int width,
+                                         int height)
+{
+        if (m_draw_batch_fills) {
+                struct vte_draw_fill_rect fill;
+                guint i;
+
+                /* Only the current and the previous row need to be looked at */
+                for (i = m_draw_fill_rects->len; i > 0; i--) {
+                        struct vte_draw_fill_rect const* queued =
+                                &g_array_index(m_draw_fill_rects, struct vte_draw_fill_rect, i - 1);
+                        if (queued->rect.y + queued->rect.height <= y - m_char_height)
+                                break;
+                        if (queued->color != color &&
+                            queued->rect.x < x + width && x < queued->rect.x + queued->rect.width &&
+                            queued->rect.y < y + height && y < queued->rect.y + queued->rect.height) {
+                                flush_fill_rectangles();
+                                break;
+                        }
+                }
+
+                fill.color = color;
+                fill.rect.x = x;
+                fill.rect.y = y;
+                fill.rect.width = width;
+                fill.rect.height = height;
+                g_array_append_val(m_draw_fill_rects, fill);
+        } else {
+                vte::color::rgb rgb;
+                rgb_from_index(color, rgb);
+                _vte_draw_fill_rectangle(m_draw, x, y, width, height, &rgb, VTE_DRAW_OPAQUE);
+        }
+}
+
+/* Like _vte_draw_draw_line(), but going through queue_fill_rectangle(). */
+void
+VteTerminalPrivate::queue_line(guint color,
+                               int x,
+                               int y,
+                               int xp,
+                               int yp)
+{
+        queue_fill_rectangle(color,
+                             x, y,
+                             MAX(VTE_LINE_WIDTH, xp - x + 1), MAX(VTE_LINE_WIDTH, yp - y + 1));
+}
+
+static int
+compare_fill_rects(gconstpointer a,
+                   gconstpointer b)
+{
+        struct vte_draw_fill_rect const* fa = (struct vte_draw_fill_rect const*) a;
+        struct vte_draw_fill_rect const* fb = (struct vte_draw_fill_rect const*) b;
+
+        /* By color, then row by row from the left */
+        if (fa->color != fb->color)
+                return fa->color < fb->color ? -1 : 1;
+        if (fa->rect.y != fb->rect.y)
+                return fa->rect.y < fb->rect.y ? -1 : 1;
+        return fa->rect.x < fb->rect.x ? -1 : fa->rect.x > fb->rect.x ? 1 : 0;
+}
+
+void
+VteTerminalPrivate::flush_fill_rectangles()
+{
+        guint i, j, n;
+        GArray *rects;
+
+        n = m_draw_fill_rects->len;
+        if (n == 0)
+                return;
+
+        /* Group the rectangles by color, and emit one path per color.
+         * Rectangles of different colors in here don't overlap (see
+         * queue_fill_rectangle()), so the order of the colors doesn't
+         * matter. */
+        g_array_sort(m_draw_fill_rects, compare_fill_rects);
+
+        rects = g_array_sized_new(FALSE, FALSE, sizeof(cairo_rectangle_int_t), n);
+        for (i = 0; i < n; i = j) {
+                guint color = g_array_index(m_draw_fill_rects, struct vte_draw_fill_rect, i).color;
+                vte::color::rgb rgb;
+
+                g_array_set_size(rects, 0);
+                for (j = i; j < n; j++) {
+                        struct vte_draw_fill_rect const* fill =
+                                &g_array_index(m_draw_fill_rects, struct vte_draw_fill_rect, j);
+                        if (fill->color != color)
+                                break;
+                        g_array_append_val(rects, fill->rect);
+                }
+
+                rgb_from_index(color, rgb);
+                _vte_draw_fill_rectangles(m_draw,
+                                          (cairo_rectangle_int_t const*) rects->data, rects->len,
+                                          &rgb, VTE_DRAW_OPAQUE);
+        }
+        g_array_free(rects, TRUE);
+
+        g_array_set_size(m_draw_fill_rects, 0);
+}
+
 /* Draw a string of characters with similar attributes. */
 void
 VteTerminalPrivate::draw_cells(struct _vte_draw_text_request *items,
@@ -8854,8 +9656,9 @@ VteTerminalPrivate::draw_cells(struct _vte_draw_text_request *items,
 			columns += items[i].columns;
 		}
 		if (clear && (draw_default_bg || back != VTE_DEFAULT_BG)) {
-			gint bold_offset = _vte_draw_has_bold(m_draw,
-									VTE_DRAW_BOLD) ? 0 : bold;
+			/* Only ask for the bold font when there is bold text */
+			gint bold_offset = bold && !_vte_draw_has_bold(m_draw,
+									VTE_DRAW_BOLD);
 			_vte_draw_fill_rectangle(m_draw,
 					x,
                                         y,
@@ -8879,39 +9682,32 @@ VteTerminalPrivate::draw_cells(struct _vte_draw_text_request *items,
 				columns += items[i].columns;
 			}
 			if (underline) {
-                                _vte_draw_draw_line(m_draw,
-						x,
-						y + m_underline_position,
-						x + (columns * column_width) - 1,
-                                                    y + m_underline_position + m_line_thickness - 1,
-                                                    VTE_LINE_WIDTH,
-                                                    &fg, VTE_DRAW_OPAQUE);
+                                queue_line(fore,
+                                           x,
+                                           y + m_underline_position,
+                                           x + (columns * column_width) - 1,
+                                           y + m_underline_position + m_line_thickness - 1);
 			}
 			if (strikethrough) {
-                                _vte_draw_draw_line(m_draw,
-						x,
-						y + m_strikethrough_position,
-						x + (columns * column_width) - 1,
-                                                       y + m_strikethrough_position + m_line_thickness - 1,
-                                                       VTE_LINE_WIDTH,
-                                                       &fg, VTE_DRAW_OPAQUE);
+                                queue_line(fore,
+                                           x,
+                                           y + m_strikethrough_position,
+                                           x + (columns * column_width) - 1,
+                                           y + m_strikethrough_position + m_line_thickness - 1);
 			}
 			if (hilite) {
-                                _vte_draw_draw_line(m_draw,
-						x,
-						y + row_height - 1,
-						x + (columns * column_width) - 1,
-                                                       y + row_height - 1,
-                                                       VTE_LINE_WIDTH,
-                                                       &fg, VTE_DRAW_OPAQUE);
+                                queue_line(fore,
+                                           x,
+                                           y + row_height - 1,
+                                           x + (columns * column_width) - 1,
+                                           y + row_height - 1);
                         } else if (hyperlink) {
                                 for (double j = 1.0 / 6.0; j < columns; j += 0.5) {
-                                        _vte_draw_fill_rectangle(m_draw,
-                                                                 x + j * column_width,
-                                                                 y + row_height - 1,
-                                                                 MAX(column_width / 6.0, 1.0),
-                                                                 1,
-                                                                 &fg, VTE_DRAW_OPAQUE);
+                                        queue_fill_rectangle(fore,
+                                                             x + j * column_width,
+                                                             y + row_height - 1,
+                                                             MAX(column_width / 6.0, 1.0),
+                                                             1);
                                 }
                         }
 			if (boxed) {
@@ -9152,6 +9948,239 @@ VteTerminalPrivate::draw_cells_with_attributes(struct _vte_draw_text_request *it
 }
 
 
+/* The bits of the first word of VteCellAttr that affect how a cell is drawn,
+ * that is everything but the fragment flag and the number of columns. */
+static guint64
+vte_cell_attr_style_mask()
+{
+        static guint64 mask = 0;
+
+        if (G_UNLIKELY(mask == 0)) {
+                VteCellAttr attr;
+                memset(&attr, 0xff, sizeof(attr));
+                attr.fragment = 0;
+                attr.columns = 0;
+                memcpy(&mask, &attr, sizeof(mask));
+        }
+
+        return mask;
+}
+
+static inline guint64
+vte_cell_attr_style_word(VteCellAttr const* attr,
+                         guint64 mask)
+{
+        guint64 word;
+
+        memcpy(&word, attr, sizeof(word));
+        return word & mask;
+}
+
+static inline bool
+vte_draw_run_same_text_style(struct vte_draw_run const* a,
+                             struct vte_draw_run const* b)
+{
+        return a->fore == b->fore &&
+                a->bold == b->bold &&
+                a->italic == b->italic &&
+                a->underline == b->underline &&
+                a->strikethrough == b->strikethrough &&
+                a->hyperlink == b->hyperlink &&
+                a->hilite == b->hilite;
+}
+
+/* Returns the columns [*start, *end) of @row that cell_is_selected() considers
+ * selected, or false if there are none. */
+bool
+VteTerminalPrivate::selection_columns_for_row(vte::grid::row_t row,
+                                              vte::grid::column_t *start,
+                                              vte::grid::column_t *end) const
+{
+        if (!m_has_selection)
+                return false;
+
+        auto const& ss = m_selection_start;
+        auto const& se = m_selection_end;
+        if ((ss.row < 0) || (se.row < 0))
+                return false;
+        /* Negative selection never allowed. */
+        if ((ss.row > se.row) || ((ss.row == se.row) && (ss.col > se.col)))
+                return false;
+        if (row < ss.row || row > se.row)
+                return false;
+
+        vte::grid::column_t s = (row == ss.row) ? ss.col : 0;
+        vte::grid::column_t e = (row == se.row) ? se.col + 1 : G_MAXLONG;
+        if (m_selection_block_mode) {
+                s = MAX(s, ss.col);
+                e = MIN(e, se.col + 1);
+        }
+        if (s >= e)
+                return false;
+
+        *start = s;
+        *end = e;
+        return true;
+}
+
+void
+VteTerminalPrivate::append_draw_run(vte::grid::row_t row,
+                                    vte::grid::column_t start,
+                                    vte::grid::column_t end,
+                                    VteCellAttr const* attr,
+                                    bool selected,
+                                    bool hyperlink,
+                                    bool hilite)
+{
+        struct vte_draw_run run;
+
+        run.row = row;
+        run.start = start;
+        run.end = end;
+        determine_colors(attr, selected, false /* not cursor */, &run.fore, &run.back);
+        run.bold = attr->bold;
+        run.italic = attr->italic;
+        run.underline = attr->underline;
+        run.strikethrough = attr->strikethrough;
+        run.hyperlink = hyperlink;
+        run.hilite = hilite;
+        g_array_append_val(m_draw_runs, run);
+}
+
+/* Splits a row into runs of cells that are drawn identically and appends
+ * them to m_draw_runs.  Cells are compared by their packed attribute word;
+ * the selection and the match highlight are folded in by intersecting their
+ * column spans with the row instead of checking every cell. */
+void
+VteTerminalPrivate::resolve_row_runs(VteRowData const* row_data,
+                                     vte::grid::row_t row,
+                                     vte::grid::column_t start_column,
+                                     vte::grid::column_t end_column)
+{
+        guint64 const mask = vte_cell_attr_style_mask();
+        vte::grid::column_t sel_start = 0, sel_end = 0;
+        vte::grid::column_t match_start = 0, match_end = 0;
+        vte::grid::column_t i, next;
+        VteCell const* cell;
+        VteCellAttr const* attr;
+        VteCellAttr run_attr;
+        guint64 word, run_word = 0;
+        vte::grid::column_t run_start = 0, run_end = 0;
+        bool selected, hyperlink, hilite;
+        bool run_selected = false, run_hyperlink = false, run_hilite = false;
+        bool have_run = false;
+
+        selection_columns_for_row(row, &sel_start, &sel_end);
+
+        if (m_hyperlink_hover_idx == 0 && m_show_match &&
+            row >= m_match_span.start_row() && row <= m_match_span.end_row()) {
+                match_start = (row == m_match_span.start_row()) ? m_match_span.start_column() : 0;
+                match_end = (row == m_match_span.end_row()) ? m_match_span.end_column() + 1 : G_MAXLONG;
+        }
+
+	/* Back up in case this is a multicolumn character,
+	 * making the drawing area a little wider. */
+        i = start_column;
+        if (row_data != nullptr) {
+                cell = _vte_row_data_get(row_data, i);
+                if (cell != nullptr) {
+                        while (cell->attr.fragment && i > 0)
+                                cell = _vte_row_data_get(row_data, --i);
+                }
+        }
+
+        while (i < end_column) {
+                cell = row_data ? _vte_row_data_get(row_data, i) : nullptr;
+                if (cell != nullptr) {
+                        /* Fragments of multicolumn characters are drawn
+                         * along with their initial portion. */
+                        if (cell->attr.fragment && have_run) {
+                                run_end = MAX(run_end, i + 1);
+                                i++;
+                                continue;
+                        }
+                        attr = &cell->attr;
+                        next = i + attr->columns;
+                        hyperlink = m_allow_hyperlink && attr->hyperlink_idx != 0;
+                        hilite = attr->hyperlink_idx != 0 && attr->hyperlink_idx == m_hyperlink_hover_idx;
+                } else {
+                        /* Past the end of the row's data everything looks
+                         * the same up to the next selection or match edge. */
+                        attr = &basic_cell.attr;
+                        next = end_column;
+                        if (i < sel_start)
+                                next = MIN(next, sel_start);
+                        else if (i < sel_end)
+                                next = MIN(next, sel_end);
+                        if (i < match_start)
+                                next = MIN(next, match_start);
+                        else if (i < match_end)
+                                next = MIN(next, match_end);
+                        hyperlink = false;
+                        hilite = false;
+                }
+
+                selected = i >= sel_start && i < sel_end;
+                hilite = hilite || (i >= match_start && i < match_end);
+                word = vte_cell_attr_style_word(attr, mask);
+
+                if (have_run &&
+                    word == run_word &&
+                    selected == run_selected &&
+                    hyperlink == run_hyperlink &&
+                    hilite == run_hilite) {
+                        run_end = next;
+                } else {
+                        if (have_run)
+                                append_draw_run(row, run_start, run_end, &run_attr,
+                                                run_selected, run_hyperlink, run_hilite);
+                        have_run = true;
+                        run_start = i;
+                        run_end = next;
+                        run_attr = *attr;
+                        run_word = word;
+                        run_selected = selected;
+                        run_hyperlink = hyperlink;
+                        run_hilite = hilite;
+                }
+
+                i = next;
+        }
+
+        if (have_run)
+                append_draw_run(row, run_start, run_end, &run_attr,
+                                run_selected, run_hyperlink, run_hilite);
+}
+
+void
+VteTerminalPrivate::draw_run_cells(struct _vte_draw_text_request *items,
+                                   gssize n,
+                                   struct vte_draw_run const* run,
+                                   int column_width,
+                                   int row_height)
+{
+        draw_cells(items, n,
+                   run->fore, run->back, FALSE, FALSE,
+                   run->bold, run->italic, run->underline,
+                   run->strikethrough, run->hyperlink, run->hilite, FALSE,
+                   column_width, row_height);
+}
+
+/* Returns the time elapsed since *@then and moves *@then to now, or 0
+ * without looking at the clock if @enabled is false. */
+static inline gint64
+draw_timing_lap(bool enabled,
+                gint64 *then)
+{
+        if (G_LIKELY(!enabled))
+                return 0;
+
+        gint64 now = g_get_monotonic_time();
+        gint64 elapsed = now - *then;
+        *then = now;
+        return elapsed;
+}
+
 /* Paint the contents of a given row at the given location.  Take advantage
  * of multiple-draw APIs by finding runs of characters with identical
  * attributes and bundling them together. */
@@ -9167,304 +10196,129 @@ VteTerminalPrivate::draw_rows(VteScreen *screen_,
                               gint row_height)
 {
 	struct _vte_draw_text_request items[4*VTE_DRAW_MAX_LENGTH];
-        vte::grid::row_t row, rows;
-        vte::grid::column_t i, j;
-        long x, y;
-	guint fore, nfore, back, nback;
-        gboolean underline, nunderline, bold, nbold, italic, nitalic,
-                 hyperlink, nhyperlink, hilite, nhilite,
-		 selected, nselected, strikethrough, nstrikethrough;
-	guint item_count;
+        vte::grid::row_t row;
+        vte::grid::column_t i;
+        long y = 0;
+        guint item_count, n_runs, k;
+        struct vte_draw_run const* run;
+        struct vte_draw_run const* first;
+        struct vte_draw_run const* style = nullptr;
 	const VteCell *cell;
-	VteRowData const* row_data;
+	VteRowData const* row_data = nullptr;
+        gint64 lap = m_draw_timings_enabled ? g_get_monotonic_time() : 0;
 
 	/* adjust for the absolute start of row */
 	start_x -= start_column * column_width;
 
-	/* clear the background */
-	x = start_x;
-	y = start_y;
-	row = start_row;
-	rows = end_row - start_row;
-	do {
-		row_data = find_row_data(row);
-		/* Back up in case this is a multicolumn character,
-		 * making the drawing area a little wider. */
-		i = start_column;
-		if (row_data != NULL) {
-			cell = _vte_row_data_get (row_data, i);
-			if (cell != NULL) {
-				while (cell->attr.fragment && i > 0) {
-					cell = _vte_row_data_get (row_data, --i);
-				}
-			}
-			/* Walk the line. */
-			do {
-				/* Get the character cell's contents. */
-				cell = _vte_row_data_get (row_data, i);
-				/* Find the colors for this cell. */
-				selected = cell_is_selected(i, row);
-				determine_colors(cell, selected, &fore, &back);
-
-				bold = cell && cell->attr.bold;
-				j = i + (cell ? cell->attr.columns : 1);
-
-				while (j < end_column){
-					/* Retrieve the cell. */
-					cell = _vte_row_data_get (row_data, j);
-					/* Don't render fragments of multicolumn characters
-					 * which have the same attributes as the initial
-					 * portions. */
-					if (cell != NULL && cell->attr.fragment) {
-						j++;
-						continue;
-					}
-					/* Resolve attributes to colors where possible and
-					 * compare visual attributes to the first character
-					 * in this chunk. */
-					selected = cell_is_selected(j, row);
-					determine_colors(cell, selected, &nfore, &nback);
-					if (nback != back) {
-						break;
-					}
-					bold = cell && cell->attr.bold;
-					j += cell ? cell->attr.columns : 1;
-				}
-				if (back != VTE_DEFAULT_BG) {
-					vte::color::rgb bg;
-					gint bold_offset = _vte_draw_has_bold(m_draw,
-											VTE_DRAW_BOLD) ? 0 : bold;
-					rgb_from_index(back, bg);
-					_vte_draw_fill_rectangle (
-							m_draw,
-							x + i * column_width,
-							y,
-							(j - i) * column_width + bold_offset,
-							row_height,
-							&bg, VTE_DRAW_OPAQUE);
-				}
-				/* We'll need to continue at the first cell which didn't
-				 * match the first one in this set. */
-				i = j;
-			} while (i < end_column);
-		} else {
-			do {
-				selected = cell_is_selected(i, row);
-				j = i + 1;
-				while (j < end_column){
-					nselected = cell_is_selected(j, row);
-					if (nselected != selected) {
-						break;
-					}
-					j++;
-				}
-				determine_colors(nullptr, selected, &fore, &back);
-				if (back != VTE_DEFAULT_BG) {
-					vte::color::rgb bg;
-					rgb_from_index(back, bg);
-					_vte_draw_fill_rectangle (m_draw,
-								  x + i *column_width,
-								  y,
-								  (j - i)  * column_width,
-								  row_height,
-								  &bg, VTE_DRAW_OPAQUE);
-				}
-				i = j;
-			} while (i < end_column);
-		}
-		row++;
-		y += row_height;
-	} while (--rows);
+        /* Walk every row once, resolving it into runs of identically drawn
+         * cells; both passes below work on these runs. */
+        g_array_set_size(m_draw_runs, 0);
+        for (row = start_row; row < end_row; row++)
+                resolve_row_runs(find_row_data(row), row, start_column, end_column);
+        n_runs = m_draw_runs->len;
+        m_draw_timings.runs += draw_timing_lap(m_draw_timings_enabled, &lap);
+
+        /* Backgrounds and text decorations are gathered for the whole area
+         * and then filled with one path per color. */
+        m_draw_batch_fills = true;
 
+	/* clear the background */
+        for (k = 0; k < n_runs; ) {
+                first = run = &g_array_index(m_draw_runs, struct vte_draw_run, k);
+                /* Merge adjacent runs that only differ in their foreground. */
+                while (++k < n_runs) {
+                        struct vte_draw_run const* next = &g_array_index(m_draw_runs, struct vte_draw_run, k);
+                        if (next->row != first->row || next->back != first->back)
+                                break;
+                        run = next;
+                }
+                if (first->back != VTE_DEFAULT_BG) {
+                        queue_fill_rectangle(first->back,
+                                             start_x + first->start * column_width,
+                                             start_y + (first->row - start_row) * row_height,
+                                             (run->end - first->start) * column_width +
+                                             (run->bold && !_vte_draw_has_bold(m_draw, VTE_DRAW_BOLD)),
+                                             row_height);
+                }
+        }
+        flush_fill_rectangles();
+        m_draw_timings.background += draw_timing_lap(m_draw_timings_enabled, &lap);
 
 	/* render the text */
-	y = start_y;
-	row = start_row;
-	rows = end_row - start_row;
-	item_count = 1;
-	do {
-		row_data = find_row_data(row);
-		if (row_data == NULL) {
-			goto fg_skip_row;
-		}
-		/* Back up in case this is a multicolumn character,
-		 * making the drawing area a little wider. */
-		i = start_column;
-		cell = _vte_row_data_get (row_data, i);
-		if (cell == NULL) {
-			goto fg_skip_row;
-		}
-		while (cell->attr.fragment && i > 0)
-			cell = _vte_row_data_get (row_data, --i);
+        item_count = 0;
+        row = start_row - 1;
+        for (k = 0; k < n_runs; k++) {
+                run = &g_array_index(m_draw_runs, struct vte_draw_run, k);
+                if (run->row != row) {
+                        row = run->row;
+                        row_data = find_row_data(row);
+                        y = start_y + (row - start_row) * row_height;
+                }
+                if (row_data == nullptr)
+                        continue;
 
-		/* Walk the line. */
-		do {
-			/* Get the character cell's contents. */
-			cell = _vte_row_data_get (row_data, i);
-			if (cell == NULL) {
-				goto fg_skip_row;
-			}
-			while (cell->c == 0 || cell->attr.invisible ||
-					(cell->c == ' ' &&
-					 !cell->attr.underline &&
-                                         !cell->attr.strikethrough &&
-                                         (!m_allow_hyperlink || cell->attr.hyperlink_idx == 0)) ||
-					cell->attr.fragment) {
-				if (++i >= end_column) {
-					goto fg_skip_row;
-				}
-				cell = _vte_row_data_get (row_data, i);
-				if (cell == NULL) {
-					goto fg_skip_row;
-				}
-			}
-			/* Find the colors for this cell. */
-			selected = cell_is_selected(i, row);
-			determine_colors(cell, selected, &fore, &back);
-			underline = cell->attr.underline;
-			strikethrough = cell->attr.strikethrough;
-                        hyperlink = (m_allow_hyperlink && cell->attr.hyperlink_idx != 0);
-			bold = cell->attr.bold;
-			italic = cell->attr.italic;
-                        if (cell->attr.hyperlink_idx != 0 && cell->attr.hyperlink_idx == m_hyperlink_hover_idx) {
-                                hilite = true;
-                        } else if (m_hyperlink_hover_idx == 0 && m_show_match) {
-				hilite = m_match_span.contains(row, i);
-			} else {
-				hilite = false;
-			}
+                for (i = run->start; i < run->end; ) {
+                        cell = _vte_row_data_get(row_data, i);
+                        if (cell == nullptr)
+                                break;
+
+                        /* Don't render fragments of multicolumn characters
+                         * which have the same attributes as the initial
+                         * portions.  Don't render invisible cells */
+                        if (cell->attr.fragment || cell->attr.invisible) {
+                                i++;
+                                continue;
+                        }
+                        if (cell->c == 0) {
+                                /* only break the run if we
+                                 * are drawing attributes
+                                 */
+                                if (item_count > 0 &&
+                                    (style->underline || style->strikethrough ||
+                                     style->hyperlink || style->hilite)) {
+                                        draw_run_cells(items, item_count, style, column_width, row_height);
+                                        item_count = 0;
+                                }
+                                i++;
+                                continue;
+                        }
 
-			items[0].c = cell->c;
-			items[0].columns = cell->attr.columns;
-			items[0].x = start_x + i * column_width;
-			items[0].y = y;
-			j = i + items[0].columns;
+                        if (item_count > 0 &&
+                            (item_count == G_N_ELEMENTS(items) ||
+                             (style != run && !vte_draw_run_same_text_style(style, run)))) {
+                                draw_run_cells(items, item_count, style, column_width, row_height);
+                                item_count = 0;
+                        }
 
-			/* Now find out how many cells have the same attributes. */
-			do {
-				while (j < end_column &&
-						item_count < G_N_ELEMENTS(items)) {
-					/* Retrieve the cell. */
-					cell = _vte_row_data_get (row_data, j);
-					if (cell == NULL) {
-						goto fg_next_row;
-					}
-					/* Don't render blank cells or fragments of multicolumn characters
-					 * which have the same attributes as the initial
-					 * portions.  Don't render invisible cells */
-					if (cell->attr.fragment || cell->attr.invisible) {
-						j++;
-						continue;
-					}
-					if (cell->c == 0){
-						/* only break the run if we
-						 * are drawing attributes
-						 */
-                                                if (underline || strikethrough || hyperlink || hilite) {
-							break;
-						} else {
-							j++;
-							continue;
-						}
-					}
-					/* Resolve attributes to colors where possible and
-					 * compare visual attributes to the first character
-					 * in this chunk. */
-					selected = cell_is_selected(j, row);
-					determine_colors(cell, selected, &nfore, &nback);
-					if (nfore != fore) {
-						break;
-					}
-					nbold = cell->attr.bold;
-					if (nbold != bold) {
-						break;
-					}
-					nitalic = cell->attr.italic;
-					if (nitalic != italic) {
-						break;
-					}
-					/* Break up underlined/not-underlined text. */
-					nunderline = cell->attr.underline;
-					if (nunderline != underline) {
-						break;
-					}
-					nstrikethrough = cell->attr.strikethrough;
-					if (nstrikethrough != strikethrough) {
-						break;
-					}
-                                        nhyperlink = (m_allow_hyperlink && cell->attr.hyperlink_idx != 0);
-                                        if (nhyperlink != hyperlink) {
-                                                break;
-                                        }
-					/* Break up matched/not-matched text. */
-					nhilite = false;
-                                        if (cell->attr.hyperlink_idx != 0 && cell->attr.hyperlink_idx == m_hyperlink_hover_idx) {
-                                                nhilite = true;
-                                        } else if (m_hyperlink_hover_idx == 0 && m_show_match) {
-						nhilite = m_match_span.contains(row, j);
-					}
-					if (nhilite != hilite) {
-						break;
-					}
-					/* Add this cell to the draw list. */
-					items[item_count].c = cell->c;
-					items[item_count].columns = cell->attr.columns;
-					items[item_count].x = start_x + j * column_width;
-					items[item_count].y = y;
-					j +=  items[item_count].columns;
-					item_count++;
-				}
-				/* have we encountered a state change? */
-				if (j < end_column) {
-					break;
-				}
-fg_next_row:
-				/* is this the last column, on the last row? */
-				do {
-					do {
-						if (!--rows) {
-							goto fg_draw;
-						}
-
-						/* restart on the next row */
-						row++;
-						y += row_height;
-						row_data = find_row_data(row);
-					} while (row_data == NULL);
-
-					/* Back up in case this is a
-					 * multicolumn character, making the drawing
-					 * area a little wider. */
-					j = start_column;
-					cell = _vte_row_data_get (row_data, j);
-				} while (cell == NULL);
-				while (cell->attr.fragment && j > 0) {
-					cell = _vte_row_data_get (row_data, --j);
-				}
-			} while (TRUE);
-fg_draw:
-			/* Draw the cells. */
-			draw_cells(
-					items,
-					item_count,
-					fore, back, FALSE, FALSE,
-					bold, italic, underline,
-                                        strikethrough, hyperlink, hilite, FALSE,
-					column_width, row_height);
-			item_count = 1;
-			/* We'll need to continue at the first cell which didn't
-			 * match the first one in this set. */
-			i = j;
-			if (!rows) {
-				goto fg_out;
-			}
-		} while (i < end_column);
-fg_skip_row:
-		row++;
-		y += row_height;
-	} while (--rows);
-fg_out:
-	return;
+                        if (item_count == 0) {
+                                /* Don't start a run with blank cells */
+                                if (cell->c == ' ' &&
+                                    !run->underline &&
+                                    !run->strikethrough &&
+                                    !run->hyperlink) {
+                                        i++;
+                                        continue;
+                                }
+                                style = run;
+                        }
+
+                        /* Add this cell to the draw list. */
+                        items[item_count].c = cell->c;
+                        items[item_count].columns = cell->attr.columns;
+                        items[item_count].x = start_x + i * column_width;
+                        items[item_count].y = y;
+                        i += items[item_count].columns;
+                        item_count++;
+                }
+        }
+
+        if (item_count > 0)
+                draw_run_cells(items, item_count, style, column_width, row_height);
+        m_draw_timings.text += draw_timing_lap(m_draw_timings_enabled, &lap);
+
+        flush_fill_rectangles();
+        m_draw_batch_fills = false;
+        m_draw_timings.decorations += draw_timing_lap(m_draw_timings_enabled, &lap);
 }
 
 void
@@ -9850,6 +10704,8 @@ VteTerminalPrivate::widget_draw(cairo_t *cr)
         cairo_region_destroy (region);
 
         m_invalidated_all = FALSE;
+
+        maybe_schedule_idle_trim();
 }
 
 /* Handle an expose event by painting the exposed area. */
@@ -9904,6 +10760,7 @@ VteTerminalPrivate::widget_scroll(GdkEventScroll *event)
         GdkEvent *base_event = reinterpret_cast<GdkEvent*>(event);
         auto rowcol = confined_grid_coords_from_event(base_event);
 
+        flush_motion();
 	read_modifiers(base_event);
 
 	switch (event->direction) {
@@ -10323,6 +11180,7 @@ VteTerminalPrivate::reset(bool clear_tabstops,
 	/* Reset the color palette. Only the 256 indexed colors, not the special ones, as per xterm. */
 	for (int i = 0; i < 256; i++)
 		m_palette[i].sources[VTE_COLOR_SOURCE_ESCAPE].is_set = FALSE;
+        update_resolved_palette();
 	/* Reset the default attributes.  Reset the alternate attribute because
 	 * it's not a real attribute, but we need to treat it as one here. */
         reset_default_attributes(true);
@@ -10393,6 +11251,10 @@ VteTerminalPrivate::reset(bool clear_tabstops,
         m_mouse_pressed_buttons = 0;
         m_mouse_handled_buttons = 0;
 	m_mouse_last_position = vte::view::coords(-1, -1);
+        m_mouse_hilite_position = vte::view::coords(-1, -1);
+        m_mouse_drag_rowcol = vte::grid::coords(-1, -1);
+        m_motion_hilite_pending = false;
+        m_motion_drag_pending = false;
 	m_mouse_xterm_extension = FALSE;
 	m_mouse_urxvt_extension = FALSE;
 	m_mouse_smooth_scroll_delta = 0.;
@@ -10433,11 +11295,13 @@ VteTerminalPrivate::set_pty(VtePty *new_pty)
 		 * command, disconnecting the timeout. */
 		if (m_incoming != NULL) {
 			process_incoming();
-			_vte_incoming_chunks_release (m_incoming);
-			m_incoming = NULL;
+			release_incoming();
 			m_input_bytes = 0;
 		}
 		g_array_set_size(m_pending, 0);
+                m_pending_start = 0;
+                m_string_scanned = 0;
+                m_string_discarding = false;
 		stop_processing(this);
 
 		/* Clear the outgoing buffer as well. */
@@ -10550,15 +11414,25 @@ add_update_timeout(VteTerminalPrivate *that)
 	}
 }
 
+/* Whether display updates are currently being dropped, either because
+ * the widget is invisible or because rendering was suspended by the
+ * application. */
+bool
+VteTerminalPrivate::rendering_inhibited() const
+{
+        return m_visibility_state == GDK_VISIBILITY_FULLY_OBSCURED ||
+                m_rendering_suspended;
+}
+
 void
 VteTerminalPrivate::reset_update_rects()
 {
         g_array_set_size(m_update_rects, 0);
 
 	/* The invalidated_all flag also marks whether to skip processing
-	 * due to the widget being invisible.
+	 * due to the widget being invisible or rendering being suspended.
          */
-	m_invalidated_all = m_visibility_state == GDK_VISIBILITY_FULLY_OBSCURED;
+	m_invalidated_all = rendering_inhibited();
 }
 
 static bool
@@ -10571,6 +11445,9 @@ remove_from_active_list(VteTerminalPrivate *that)
         _vte_debug_print(VTE_DEBUG_TIMEOUT, "Removing terminal from active list\n");
         g_active_terminals = g_list_delete_link(g_active_terminals, that->m_active_terminals_link);
         that->m_active_terminals_link = nullptr;
+
+        /* Give back the input arena and stream buffers once the terminal stays idle */
+        that->schedule_idle_trim();
         return true;
 }
 
@@ -10625,13 +11502,54 @@ VteTerminalPrivate::start_processing()
 		add_process_timeout(this);
 }
 
+static gboolean
+pending_signals_timeout_cb(VteTerminalPrivate *that)
+{
+        that->m_pending_signals_tag = 0;
+        that->emit_pending_signals();
+
+        return G_SOURCE_REMOVE;
+}
+
+/* Emits the pending signals, unless that was already done during the
+ * current frame; then they go out batched once the frame is over. */
+void
+VteTerminalPrivate::queue_pending_signals()
+{
+        gint64 interval, elapsed;
+
+        if (m_pending_signals_tag != 0)
+                return;
+
+        interval = VTE_SIGNALS_INTERVAL;
+        if (m_max_frame_rate != 0)
+                interval = MAX(interval, 1000 / m_max_frame_rate);
+        elapsed = (g_get_monotonic_time() - m_last_signals_time) / 1000;
+
+        if (elapsed >= interval) {
+                emit_pending_signals();
+                return;
+        }
+
+        m_pending_signals_tag = gdk_threads_add_timeout(interval - elapsed,
+                                                        (GSourceFunc) pending_signals_timeout_cb,
+                                                        this);
+}
+
 void
 VteTerminalPrivate::emit_pending_signals()
 {
 	GObject *object = G_OBJECT(m_terminal);
-        g_object_freeze_notify(object);
         gboolean really_changed;
 
+        if (m_pending_signals_tag != 0) {
+                g_source_remove(m_pending_signals_tag);
+                m_pending_signals_tag = 0;
+        }
+        m_last_signals_time = g_get_monotonic_time();
+
+        g_object_freeze_notify(object);
+
 	emit_adjustment_changed();
 
 	if (m_window_title_changed) {
@@ -10733,14 +11651,111 @@ VteTerminalPrivate::emit_pending_signals()
         g_object_thaw_notify(object);
 }
 
+/* Guess whether @chunk is mostly text or mostly escape sequences, by the
+ * density of ESC bytes. */
+static VteContentClass
+_vte_incoming_chunks_content_class(struct _vte_incoming_chunk *chunk)
+{
+	gsize len = 0, n_sequences = 0;
+	while (chunk) {
+                guchar const* p = chunk->data;
+                guchar const* end = chunk->data + chunk->len;
+                while ((p = (guchar const*)memchr(p, 0x1b, end - p)) != nullptr) {
+                        n_sequences++;
+                        p++;
+                }
+		len += chunk->len;
+		chunk = chunk->next;
+	}
+        /* Less than 16 bytes per sequence on average */
+	return n_sequences * 16 > len ? VTE_CONTENT_CLASS_SEQUENCES : VTE_CONTENT_CLASS_TEXT;
+}
+
+/* Process the incoming data and use the measured time to update the
+ * throughput average of its content class, which in turn sizes how much
+ * is read before the next update.  Keeping separate averages for text and
+ * escape sequence heavy output stops one from skewing the budget for the
+ * other, which would starve either the display or the child. */
 void
 VteTerminalPrivate::time_process_incoming()
 {
+        gsize bytes = m_incoming_arena.buffered;
+        auto content_class = _vte_incoming_chunks_content_class(m_incoming);
+
 	g_timer_reset(process_timer);
 	process_incoming();
 	auto elapsed = g_timer_elapsed(process_timer, NULL) * 1000;
-	gssize target = VTE_MAX_PROCESS_TIME / elapsed * m_input_bytes;
-	m_max_input_bytes = (m_max_input_bytes + target) / 2;
+
+        m_process_last_time = elapsed;
+        m_process_class = content_class;
+
+        /* Anything faster than this is timer noise */
+        if (elapsed >= 0.1 && bytes >= VTE_MIN_INPUT_BUDGET) {
+                double sample = bytes / elapsed;
+                double& rate = m_process_rate[content_class];
+                if (rate > 0.)
+                        rate += VTE_PROCESS_RATE_WEIGHT * (sample - rate);
+                else
+                        rate = sample;
+        }
+
+        update_input_budget();
+}
+
+void
+VteTerminalPrivate::update_input_budget()
+{
+        double rate = m_process_rate[m_process_class];
+        if (rate <= 0.)
+                return;
+
+        double budget = rate * m_process_time_target;
+        m_max_input_bytes = CLAMP(budget, VTE_MIN_INPUT_BUDGET, VTE_MAX_INPUT_BUDGET);
+
+        _vte_debug_print(VTE_DEBUG_IO,
+                         "Input budget %ld bytes (%s, %.1f bytes/ms, last %.2fms)\n",
+                         m_max_input_bytes,
+                         m_process_class == VTE_CONTENT_CLASS_TEXT ? "text" : "sequences",
+                         rate, m_process_last_time);
+}
+
+bool
+VteTerminalPrivate::set_process_time_target(guint msec)
+{
+        if (msec == m_process_time_target)
+                return false;
+
+        m_process_time_target = msec;
+        update_input_budget();
+
+        return true;
+}
+
+/* Returns a new floating a{sv} dictionary with the internal state of the
+ * terminal that is of interest when tuning it. */
+GVariant*
+VteTerminalPrivate::get_stats()
+{
+        GVariantBuilder builder;
+
+        g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+        g_variant_builder_add(&builder, "{sv}", "process-time-target",
+                              g_variant_new_uint32(m_process_time_target));
+        g_variant_builder_add(&builder, "{sv}", "process-time-last",
+                              g_variant_new_double(m_process_last_time));
+        g_variant_builder_add(&builder, "{sv}", "process-rate-text",
+                              g_variant_new_double(m_process_rate[VTE_CONTENT_CLASS_TEXT]));
+        g_variant_builder_add(&builder, "{sv}", "process-rate-sequences",
+                              g_variant_new_double(m_process_rate[VTE_CONTENT_CLASS_SEQUENCES]));
+        g_variant_builder_add(&builder, "{sv}", "input-budget",
+                              g_variant_new_int64(m_max_input_bytes));
+        g_variant_builder_add(&builder, "{sv}", "input-arena-bytes",
+                              g_variant_new_uint64((m_incoming_arena.region != nullptr ? VTE_INPUT_ARENA_SIZE : 0) +
+                                                   m_incoming_arena.n_heap_used * sizeof(_vte_incoming_chunk_t)));
+        g_variant_builder_add(&builder, "{sv}", "scrollback-buffer-bytes",
+                              g_variant_new_uint64(_vte_ring_get_buffer_size(m_normal_screen.row_data)));
+
+        return g_variant_builder_end(&builder);
 }
 
 bool
@@ -10758,7 +11773,7 @@ VteTerminalPrivate::process(bool emit_adj_changed)
         }
         if (emit_adj_changed)
                 emit_adjustment_changed();
-        is_active = _vte_incoming_chunks_length(m_incoming) != 0;
+        is_active = m_incoming_arena.buffered != 0;
         if (is_active) {
                 if (VTE_MAX_PROCESS_TIME) {
                         time_process_incoming();
@@ -10832,9 +11847,6 @@ process_timeout (gpointer data)
 		 * at full tilt and making us run to keep up...
 		 */
 		g_usleep (0);
-	} else if (update_timeout_tag == 0) {
-		/* otherwise free up memory used to capture incoming data */
-		prune_chunks (10);
 	}
 
 	return again;
@@ -10845,7 +11857,7 @@ VteTerminalPrivate::invalidate_dirty_rects_and_process_updates()
 {
         if (G_UNLIKELY(!widget_realized()))
                 return false;
-	if (m_visibility_state == GDK_VISIBILITY_FULLY_OBSCURED) {
+	if (rendering_inhibited()) {
 		reset_update_rects();
 		return false;
 	}
@@ -10853,6 +11865,21 @@ VteTerminalPrivate::invalidate_dirty_rects_and_process_updates()
 	if (G_UNLIKELY (!m_update_rects->len))
 		return false;
 
+        /* Keep accumulating damage until the next frame is due; staying
+         * active means we get called again from the repeat timeout. */
+        if (m_max_frame_rate != 0) {
+                auto now = g_get_monotonic_time();
+                if (now - m_last_frame_time < G_USEC_PER_SEC / m_max_frame_rate) {
+                        /* Don't let the array grow without bounds in between */
+                        if (m_update_rects->len > 64) {
+                                m_invalidated_all = false;
+                                invalidate_all();
+                        }
+                        return true;
+                }
+                m_last_frame_time = now;
+        }
+
         auto region = cairo_region_create();
         auto n_rects = m_update_rects->len;
         for (guint i = 0; i < n_rects; i++) {
@@ -10952,9 +11979,6 @@ update_repeat_timeout (gpointer data)
 		 * at full tilt and making us run to keep up...
 		 */
 		g_usleep (0);
-	} else {
-		/* otherwise free up memory used to capture incoming data */
-		prune_chunks (10);
 	}
 
         return FALSE;  /* If we need to go again, we already have a new timer for that. */
@@ -11024,9 +12048,11 @@ VteTerminalPrivate::write_contents_sync (GOutputStream *stream,
                                          GCancellable *cancellable,
                                          GError **error)
 {
-	return _vte_ring_write_contents (m_screen->row_data,
-					 stream, flags,
-					 cancellable, error);
+	bool ret = _vte_ring_write_contents (m_screen->row_data,
+                                             stream, flags,
+                                             cancellable, error);
+        maybe_schedule_idle_trim();
+        return ret;
 }
 
 /*
@@ -11323,6 +12349,43 @@ VteTerminalPrivate::set_input_enabled (bool enabled)
         return true;
 }
 
+bool
+VteTerminalPrivate::set_max_frame_rate(guint fps)
+{
+        if (fps == m_max_frame_rate)
+                return false;
+
+        m_max_frame_rate = fps;
+        /* Don't hold back the first frame after changing the limit */
+        m_last_frame_time = 0;
+
+        return true;
+}
+
+bool
+VteTerminalPrivate::set_rendering_suspended(bool suspended)
+{
+        if (suspended == m_rendering_suspended)
+                return false;
+
+        _vte_debug_print(VTE_DEBUG_UPDATES,
+                         "%s rendering.\n", suspended ? "Suspending" : "Resuming");
+
+        m_rendering_suspended = suspended;
+
+        if (suspended) {
+                /* Drop all pending damage, and act like we have invalidated
+                 * all so that no more is accumulated while suspended. */
+                reset_update_rects();
+        } else if (m_visibility_state != GDK_VISIBILITY_FULLY_OBSCURED) {
+                /* Whatever happened in the meantime, redraw it all at once */
+                m_invalidated_all = false;
+                invalidate_all();
+        }
+
+        return true;
+}
+
 bool
 VteTerminalPrivate::process_word_char_exceptions(char const *str,
                                                  gunichar **arrayp,
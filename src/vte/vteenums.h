@@ -152,6 +152,34 @@ typedef enum {
         VTE_FORMAT_HTML = 2
 } VteFormat;
 
+/**
+ * VteTextAttributeFlags:
+ * @VTE_TEXT_ATTRIBUTE_BOLD: the text is bold
+ * @VTE_TEXT_ATTRIBUTE_ITALIC: the text is italic
+ * @VTE_TEXT_ATTRIBUTE_UNDERLINE: the text is underlined
+ * @VTE_TEXT_ATTRIBUTE_STRIKETHROUGH: the text is struck through
+ * @VTE_TEXT_ATTRIBUTE_REVERSE: foreground and background are swapped when drawing
+ * @VTE_TEXT_ATTRIBUTE_BLINK: the text blinks
+ * @VTE_TEXT_ATTRIBUTE_DIM: the text is dim
+ * @VTE_TEXT_ATTRIBUTE_INVISIBLE: the text is invisible
+ * @VTE_TEXT_ATTRIBUTE_HYPERLINK: the text is part of a hyperlink
+ *
+ * Flags describing the rendition of a #VteTextAttributeRun.
+ *
+ * Since: 0.52
+ */
+typedef enum /*< flags >*/ {
+        VTE_TEXT_ATTRIBUTE_BOLD          = 1 << 0,
+        VTE_TEXT_ATTRIBUTE_ITALIC        = 1 << 1,
+        VTE_TEXT_ATTRIBUTE_UNDERLINE     = 1 << 2,
+        VTE_TEXT_ATTRIBUTE_STRIKETHROUGH = 1 << 3,
+        VTE_TEXT_ATTRIBUTE_REVERSE       = 1 << 4,
+        VTE_TEXT_ATTRIBUTE_BLINK         = 1 << 5,
+        VTE_TEXT_ATTRIBUTE_DIM           = 1 << 6,
+        VTE_TEXT_ATTRIBUTE_INVISIBLE     = 1 << 7,
+        VTE_TEXT_ATTRIBUTE_HYPERLINK     = 1 << 8
+} VteTextAttributeFlags;
+
 G_END_DECLS
 
 #endif /* __VTE_VTE_ENUMS_H__ */
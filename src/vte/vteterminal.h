@@ -46,6 +46,7 @@ typedef struct _VteTerminal             VteTerminal;
 typedef struct _VteTerminalClass        VteTerminalClass;
 typedef struct _VteTerminalClassPrivate VteTerminalClassPrivate;
 typedef struct _VteCharAttributes       VteCharAttributes;
+typedef struct _VteTextAttributeRun     VteTextAttributeRun;
 
 /**
  * VteTerminal:
@@ -118,6 +119,34 @@ struct _VteCharAttributes {
 	guint underline:1, strikethrough:1;
 };
 
+/**
+ * VteTextAttributeRun:
+ * @start: byte offset of the run in the text
+ * @end: byte offset just past the run
+ * @row: the row of the run
+ * @column: the column of the first character of the run
+ * @fore: the resolved foreground color
+ * @back: the resolved background color
+ * @flags: a #VteTextAttributeFlags
+ * @width: the number of columns each character of the run takes
+ * @hyperlink: (nullable): the hyperlink target, or %NULL
+ *
+ * Describes a stretch of text sharing the same rendition, as returned by
+ * vte_terminal_get_text_runs().  Combining marks don't take a column of their
+ * own, so the column of any character of the run can be computed from
+ * @column and @width.  Line breaks get a run of their own with a @width of 0.
+ *
+ * Since: 0.52
+ */
+struct _VteTextAttributeRun {
+        gsize start, end;
+        long row, column;
+        PangoColor fore, back;
+        guint flags;
+        guint width;
+        char *hyperlink;
+};
+
 typedef gboolean (*VteSelectionFunc)(VteTerminal *terminal,
                                      glong column,
                                      glong row,
@@ -362,6 +391,11 @@ char *vte_terminal_get_text_range(VteTerminal *terminal,
 				  gpointer user_data,
 				  GArray *attributes) _VTE_GNUC_NONNULL(1) G_GNUC_MALLOC;
 _VTE_PUBLIC
+char *vte_terminal_get_text_runs(VteTerminal *terminal,
+                                 glong start_row, glong start_col,
+                                 glong end_row, glong end_col,
+                                 GArray **runs) _VTE_GNUC_NONNULL(1) G_GNUC_MALLOC;
+_VTE_PUBLIC
 void vte_terminal_get_cursor_position(VteTerminal *terminal,
 				      glong *column,
                                       glong *row) _VTE_GNUC_NONNULL(1);
@@ -474,6 +508,30 @@ void vte_terminal_set_input_enabled (VteTerminal *terminal,
 _VTE_PUBLIC
 gboolean vte_terminal_get_input_enabled (VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
 
+_VTE_PUBLIC
+void vte_terminal_set_max_frame_rate(VteTerminal *terminal,
+                                     guint fps) _VTE_GNUC_NONNULL(1);
+_VTE_PUBLIC
+guint vte_terminal_get_max_frame_rate(VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+void vte_terminal_set_rendering_suspended(VteTerminal *terminal,
+                                          gboolean suspended) _VTE_GNUC_NONNULL(1);
+_VTE_PUBLIC
+gboolean vte_terminal_get_rendering_suspended(VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+void vte_terminal_set_process_time_target(VteTerminal *terminal,
+                                          guint msec) _VTE_GNUC_NONNULL(1);
+_VTE_PUBLIC
+guint vte_terminal_get_process_time_target(VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+GVariant *vte_terminal_get_stats(VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
+
+_VTE_PUBLIC
+void vte_terminal_flush_pending_signals(VteTerminal *terminal) _VTE_GNUC_NONNULL(1);
+
 /* Window geometry helpers */
 _VTE_PUBLIC
 void vte_terminal_get_geometry_hints(VteTerminal *terminal,
@@ -64,6 +64,9 @@
 #define VTE_PALETTE_SIZE		263
 
 #define VTE_SCROLLBACK_INIT		512
+
+/* Number of rows frozen into the streams at once when the writable part of the ring is full. */
+#define VTE_RING_FREEZE_BATCH           16
 #define VTE_DEFAULT_CURSOR		GDK_XTERM
 #define VTE_MOUSING_CURSOR		GDK_LEFT_PTR
 #define VTE_HYPERLINK_CURSOR		GDK_HAND2
@@ -77,13 +80,23 @@
 #define VTE_FX_PRIORITY			G_PRIORITY_DEFAULT_IDLE
 #define VTE_REGCOMP_FLAGS		REG_EXTENDED
 #define VTE_REGEXEC_FLAGS		0
-#define VTE_INPUT_CHUNK_SIZE		0x2000
+#define VTE_INPUT_CHUNK_SIZE		0x10000
+#define VTE_INPUT_ARENA_CHUNKS		32 /* 2MiB, the size of a huge page on most systems */
+#define VTE_IDLE_TRIM_TIMEOUT		10 /* seconds */
 #define VTE_MAX_INPUT_READ		0x1000
 #define VTE_INVALID_BYTE		'?'
 #define VTE_DISPLAY_TIMEOUT		10
 #define VTE_UPDATE_TIMEOUT		15
 #define VTE_UPDATE_REPEAT_TIMEOUT	30
+#define VTE_SIGNALS_INTERVAL		16 /* ms, emit deferred signals at most once per frame */
+#define VTE_RESIZE_SETTLE_TIMEOUT	150 /* ms without size changes that end an interactive resize */
+#define VTE_RESIZE_WINSIZE_INTERVAL	16 /* ms between window size updates to the child while resizing */
 #define VTE_MAX_PROCESS_TIME		100
+#define VTE_MIN_INPUT_BUDGET		0x400
+#define VTE_MAX_INPUT_BUDGET		0x100000
+#define VTE_PENDING_SHRINK_LENGTH	VTE_MAX_INPUT_BUDGET /* chars; more only happens for long string sequences */
+#define VTE_STRING_SEQUENCE_MAX_LENGTH	0x800000 /* chars of an OSC, DCS or SOS payload */
+#define VTE_PROCESS_RATE_WEIGHT		(0.25) /* of the latest sample in the throughput average */
 #define VTE_CELL_BBOX_SLACK		1
 #define VTE_DEFAULT_UTF8_AMBIGUOUS_WIDTH 1
 
@@ -68,8 +68,10 @@ _vte_double_equal(double a,
  *   - A font_info keeps uses unistr_font_info structs that represent all
  *     information needed to quickly draw a single vteunistr.  The font_info
  *     creates those unistr_font_info structs on demand and caches them
- *     indefinitely.  It uses a direct array for the ASCII range and a hash
- *     table for the rest.
+ *     indefinitely.  It uses a direct array for the ASCII range, a two-level
+ *     table of lazily allocated 256-entry pages for the rest of the BMP, and
+ *     a hash table for everything else (astral characters and combining
+ *     sequences).
  *
  *
  * Fast rendering of unistrs:
@@ -131,11 +133,26 @@ _vte_double_equal(double a,
  * letters if we can do that easily using COVERAGE_USE_CAIRO_GLYPH.  This
  * means that we precache all ASCII letters without any extra pango shaping
  * involved.
+ *
+ *
+ * Warming up the rest:
+ *
+ * Characters outside ASCII are shaped the first time they are drawn, which
+ * makes the first frame showing e.g. CJK text or a Powerline prompt
+ * noticeably slower.  After allocating a font info we therefore shape a set
+ * of commonly used ranges in low priority idle slices of at most
+ * FONT_WARMUP_SLICE microseconds each.  Pango font maps are not thread safe,
+ * so this is done on the main loop instead of in a worker thread.  The set
+ * of ranges can be overridden with the VTE_FONT_WARMUP environment variable,
+ * a comma separated list of hexadecimal ranges like "a0-ff,3000-30ff", or
+ * "none" to disable warmup.  Box drawing and block elements are drawn by
+ * vte itself and never shaped, so there is no point in listing them.
  */
 
 
 
 #define FONT_CACHE_TIMEOUT (30) /* seconds */
+#define FONT_WARMUP_SLICE (2000) /* microseconds */
 
 
 /* All shared data structures are implicitly protected by GDK mutex, because
@@ -239,8 +256,14 @@ struct font_info {
 
 	/* cache of character info */
 	struct unistr_info ascii_unistr_info[128];
+	struct unistr_info *bmp_unistr_info[256]; /* pages of 256, lazily allocated */
 	GHashTable *other_unistr_info;
 
+	/* idle warmup of commonly used characters */
+	guint warmup_source;
+	guint warmup_range;
+	gunichar warmup_next;
+
 	/* cell metrics */
 	gint width, height, ascent;
 
@@ -263,6 +286,15 @@ font_info_find_unistr_info (struct font_info    *info,
 	if (G_LIKELY (c < G_N_ELEMENTS (info->ascii_unistr_info)))
 		return &info->ascii_unistr_info[c];
 
+	if (G_LIKELY (c < 0x10000)) {
+		struct unistr_info **page = &info->bmp_unistr_info[c >> 8];
+
+		if (G_UNLIKELY (*page == NULL))
+			*page = g_new0 (struct unistr_info, 256);
+
+		return &(*page)[c & 0xff];
+	}
+
 	if (G_UNLIKELY (info->other_unistr_info == NULL))
 		info->other_unistr_info = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) unistr_info_destroy);
 
@@ -413,6 +445,8 @@ font_info_measure_font (struct font_info *info)
 }
 
 
+static void font_info_start_warmup (struct font_info *info);
+
 static struct font_info *
 font_info_allocate (PangoContext *context)
 {
@@ -434,13 +468,15 @@ font_info_allocate (PangoContext *context)
 
 	font_info_measure_font (info);
 
+	font_info_start_warmup (info);
+
 	return info;
 }
 
 static void
 font_info_free (struct font_info *info)
 {
-	vteunistr i;
+	vteunistr i, j;
 
 #ifdef VTE_DEBUG
 	_vte_debug_print (VTE_DEBUG_PANGOCAIRO,
@@ -452,12 +488,23 @@ font_info_free (struct font_info *info)
 			  info->coverage_count[3]);
 #endif
 
+	if (info->warmup_source)
+		g_source_remove (info->warmup_source);
+
 	g_string_free (info->string, TRUE);
 	g_object_unref (info->layout);
 
 	for (i = 0; i < G_N_ELEMENTS (info->ascii_unistr_info); i++)
 		unistr_info_finish (&info->ascii_unistr_info[i]);
-		
+
+	for (i = 0; i < G_N_ELEMENTS (info->bmp_unistr_info); i++) {
+		if (info->bmp_unistr_info[i] == NULL)
+			continue;
+		for (j = 0; j < 256; j++)
+			unistr_info_finish (&info->bmp_unistr_info[i][j]);
+		g_free (info->bmp_unistr_info[i]);
+	}
+
 	if (info->other_unistr_info) {
 		g_hash_table_destroy (info->other_unistr_info);
 	}
@@ -666,6 +713,11 @@ font_info_create_for_widget (GtkWidget                  *widget,
 	return font_info_create_for_screen (screen, desc, language);
 }
 
+/* Cache misses of font_info_get_unistr_info() and the time spent shaping
+ * them, across all font infos; see _vte_draw_get_glyph_lookup_stats(). */
+static guint glyph_lookup_misses;
+static gint64 glyph_lookup_time;
+
 static struct unistr_info *
 font_info_get_unistr_info (struct font_info *info,
 			   vteunistr c)
@@ -674,11 +726,13 @@ font_info_get_unistr_info (struct font_info *info,
 	union unistr_font_info *ufi;
 	PangoRectangle logical;
 	PangoLayoutLine *line;
+	gint64 start;
 
 	uinfo = font_info_find_unistr_info (info, c);
 	if (G_LIKELY (uinfo->coverage != COVERAGE_UNKNOWN))
 		return uinfo;
 
+	start = g_get_monotonic_time ();
 	ufi = &uinfo->ufi;
 
 	g_string_set_size (info->string, 0);
@@ -736,6 +790,9 @@ font_info_get_unistr_info (struct font_info *info,
 	/* release internal layout resources */
 	pango_layout_set_text (info->layout, "", -1);
 
+	glyph_lookup_misses++;
+	glyph_lookup_time += g_get_monotonic_time () - start;
+
 #ifdef VTE_DEBUG
 	info->coverage_count[0]++;
 	info->coverage_count[uinfo->coverage]++;
@@ -744,6 +801,116 @@ font_info_get_unistr_info (struct font_info *info,
 	return uinfo;
 }
 
+struct font_warmup_range {
+	gunichar first, last; /* inclusive */
+};
+
+static const struct font_warmup_range default_font_warmup_ranges[] = {
+	{ 0x00a0, 0x017f }, /* Latin-1 Supplement, Latin Extended-A */
+	{ 0x3000, 0x30ff }, /* CJK Symbols and Punctuation, Hiragana, Katakana */
+	{ 0xe0a0, 0xe0d4 }, /* Powerline symbols */
+	{ 0xff00, 0xffef }, /* Halfwidth and Fullwidth Forms */
+};
+
+static gint
+compare_font_warmup_ranges (gconstpointer a,
+			    gconstpointer b)
+{
+	const struct font_warmup_range *ra = (const struct font_warmup_range *) a;
+	const struct font_warmup_range *rb = (const struct font_warmup_range *) b;
+
+	return ra->first < rb->first ? -1 : ra->first > rb->first ? 1 : 0;
+}
+
+static GArray *
+font_warmup_ranges (void)
+{
+	static GArray *ranges = NULL;
+	const char *env;
+	char **tokens;
+	guint i;
+
+	if (G_LIKELY (ranges != NULL))
+		return ranges;
+
+	ranges = g_array_new (FALSE, FALSE, sizeof (struct font_warmup_range));
+
+	env = g_getenv ("VTE_FONT_WARMUP");
+	if (env == NULL) {
+		g_array_append_vals (ranges, default_font_warmup_ranges,
+				     G_N_ELEMENTS (default_font_warmup_ranges));
+		return ranges;
+	}
+	if (strcmp (env, "none") == 0)
+		return ranges;
+
+	tokens = g_strsplit (env, ",", -1);
+	for (i = 0; tokens[i] != NULL; i++) {
+		struct font_warmup_range range;
+		char *end;
+
+		range.first = range.last = g_ascii_strtoull (tokens[i], &end, 16);
+		if (end == tokens[i])
+			continue;
+		if (*end == '-')
+			range.last = g_ascii_strtoull (end + 1, &end, 16);
+		if (*end != '\0' || range.last < range.first ||
+		    range.last > 0x10ffff)
+			continue;
+
+		g_array_append_val (ranges, range);
+	}
+	g_strfreev (tokens);
+
+	/* The warmup walks the ranges with a single cursor */
+	g_array_sort (ranges, compare_font_warmup_ranges);
+
+	return ranges;
+}
+
+static gboolean
+font_info_warmup_cb (struct font_info *info)
+{
+	GArray *ranges = font_warmup_ranges ();
+	gint64 deadline = g_get_monotonic_time () + FONT_WARMUP_SLICE;
+	guint n = 0;
+
+	while (info->warmup_range < ranges->len) {
+		struct font_warmup_range *range = &g_array_index (ranges, struct font_warmup_range, info->warmup_range);
+
+		if (info->warmup_next < range->first)
+			info->warmup_next = range->first;
+		if (info->warmup_next > range->last) {
+			info->warmup_range++;
+			continue;
+		}
+
+		font_info_get_unistr_info (info, info->warmup_next++);
+
+		/* Checking the clock is not free either */
+		if ((++n & 0xf) == 0 && g_get_monotonic_time () >= deadline)
+			return G_SOURCE_CONTINUE;
+	}
+
+	_vte_debug_print (VTE_DEBUG_PANGOCAIRO,
+			  "vtepangocairo: %p font_info warmup done\n",
+			  info);
+
+	info->warmup_source = 0;
+	return G_SOURCE_REMOVE;
+}
+
+static void
+font_info_start_warmup (struct font_info *info)
+{
+	if (font_warmup_ranges ()->len == 0)
+		return;
+
+	info->warmup_source = gdk_threads_add_idle_full (G_PRIORITY_LOW,
+							 (GSourceFunc) font_info_warmup_cb,
+							 info, NULL);
+}
+
 guint _vte_draw_get_style(gboolean bold, gboolean italic) {
 	guint style = 0;
 	if (bold)
@@ -753,9 +920,26 @@ guint _vte_draw_get_style(gboolean bold, gboolean italic) {
 	return style;
 }
 
+/* A rendered local graphic, see _vte_draw_get_graphic_mask() */
+struct graphic_mask {
+	cairo_surface_t *surface;
+	gint column_width, row_height;
+};
+
 struct _vte_draw {
 	struct font_info *fonts[4];
 
+	/* The styled fonts are only created when first used; until then
+	 * their description is kept here, see _vte_draw_get_font(). */
+	PangoFontDescription *font_descs[4];
+	GdkScreen *screen;
+	PangoLanguage *language;
+
+	/* Alpha masks of box drawing and block element characters, keyed by
+	 * character and number of columns; emptied when the font changes. */
+	GHashTable *graphic_masks;
+	gint graphic_masks_scale;
+
 	cairo_t *cr;
 };
 
@@ -783,10 +967,17 @@ _vte_draw_free (struct _vte_draw *draw)
 		if (draw->fonts[style] != NULL &&
 			(style == 0 || draw->fonts[style] != draw->fonts[style-1])) {
 			font_info_destroy (draw->fonts[style]);
-			draw->fonts[style] = NULL;
+		}
+		draw->fonts[style] = NULL;
+		if (draw->font_descs[style] != NULL) {
+			pango_font_description_free (draw->font_descs[style]);
+			draw->font_descs[style] = NULL;
 		}
 	}
 
+	if (draw->graphic_masks != NULL)
+		g_hash_table_destroy (draw->graphic_masks);
+
 	g_slice_free (struct _vte_draw, draw);
 }
 
@@ -840,16 +1031,24 @@ _vte_draw_set_text_font (struct _vte_draw *draw,
 	PangoFontDescription *bolddesc   = NULL;
 	PangoFontDescription *italicdesc = NULL;
 	PangoFontDescription *bolditalicdesc = NULL;
-	gint style, normal, bold, ratio;
+	gint style;
 
 	_vte_debug_print (VTE_DEBUG_DRAW, "draw_set_text_font\n");
 
+	/* The cell size is likely changing, drop the rendered graphics */
+	if (draw->graphic_masks != NULL)
+		g_hash_table_remove_all (draw->graphic_masks);
+
 	/* Free all fonts (make sure to destroy every font only once)*/
 	for (style = 3; style >= 0; style--) {
 		if (draw->fonts[style] != NULL &&
 			(style == 0 || draw->fonts[style] != draw->fonts[style-1])) {
 			font_info_destroy (draw->fonts[style]);
-			draw->fonts[style] = NULL;
+		}
+		draw->fonts[style] = NULL;
+		if (draw->font_descs[style] != NULL) {
+			pango_font_description_free (draw->font_descs[style]);
+			draw->font_descs[style] = NULL;
 		}
 	}
 
@@ -865,36 +1064,54 @@ _vte_draw_set_text_font (struct _vte_draw *draw,
 	bolditalicdesc = pango_font_description_copy (bolddesc);
 	pango_font_description_set_style (bolditalicdesc, PANGO_STYLE_ITALIC);
 
+	draw->screen = gtk_widget_get_screen (widget);
+	draw->language = pango_context_get_language (gtk_widget_get_pango_context (widget));
+
+	/* Only the normal font is needed for the cell metrics; most screens
+	 * never show the others, so create those on demand. */
 	draw->fonts[VTE_DRAW_NORMAL]  = font_info_create_for_widget (widget, fontdesc);
-	draw->fonts[VTE_DRAW_BOLD]    = font_info_create_for_widget (widget, bolddesc);
-	draw->fonts[VTE_DRAW_ITALIC]  = font_info_create_for_widget (widget, italicdesc);
-	draw->fonts[VTE_DRAW_ITALIC | VTE_DRAW_BOLD] =
-                font_info_create_for_widget (widget, bolditalicdesc);
-	pango_font_description_free (bolddesc);
-	pango_font_description_free (italicdesc);
-	pango_font_description_free (bolditalicdesc);
+	draw->font_descs[VTE_DRAW_BOLD]    = bolddesc;
+	draw->font_descs[VTE_DRAW_ITALIC]  = italicdesc;
+	draw->font_descs[VTE_DRAW_ITALIC | VTE_DRAW_BOLD] = bolditalicdesc;
+}
+
+/* Returns the font for @style, creating it if it hasn't been used yet.
+ * Fonts still cached from a previous size are reused, so zooming back and
+ * forth doesn't measure them again. */
+static struct font_info *
+_vte_draw_get_font (struct _vte_draw *draw,
+		    guint style)
+{
+	struct font_info *font, *regular;
+	gint ratio;
+
+	font = draw->fonts[style];
+	if (G_LIKELY (font != NULL))
+		return font;
+
+	g_return_val_if_fail (draw->font_descs[style] != NULL, draw->fonts[VTE_DRAW_NORMAL]);
+
+	font = font_info_create_for_screen (draw->screen, draw->font_descs[style], draw->language);
+	pango_font_description_free (draw->font_descs[style]);
+	draw->font_descs[style] = NULL;
 
 	/* Decide if we should keep this bold font face, per bug 54926:
 	 *  - reject bold font if it is not within 10% of normal font width
 	 */
-	normal = VTE_DRAW_NORMAL;
-	bold   = normal | VTE_DRAW_BOLD;
-	ratio = draw->fonts[bold]->width * 100 / draw->fonts[normal]->width;
-	if (abs(ratio - 100) > 10) {
-		_vte_debug_print (VTE_DEBUG_DRAW,
-			"Rejecting bold font (%i%%).\n", ratio);
-		font_info_destroy (draw->fonts[bold]);
-		draw->fonts[bold] = draw->fonts[normal];
-	}
-	normal = VTE_DRAW_ITALIC;
-	bold   = normal | VTE_DRAW_BOLD;
-	ratio = draw->fonts[bold]->width * 100 / draw->fonts[normal]->width;
-	if (abs(ratio - 100) > 10) {
-		_vte_debug_print (VTE_DEBUG_DRAW,
-			"Rejecting italic bold font (%i%%).\n", ratio);
-		font_info_destroy (draw->fonts[bold]);
-		draw->fonts[bold] = draw->fonts[normal];
+	if (style & VTE_DRAW_BOLD) {
+		regular = _vte_draw_get_font (draw, style & ~VTE_DRAW_BOLD);
+		ratio = font->width * 100 / regular->width;
+		if (abs(ratio - 100) > 10) {
+			_vte_debug_print (VTE_DEBUG_DRAW,
+				"Rejecting %sbold font (%i%%).\n",
+				(style & VTE_DRAW_ITALIC) ? "italic " : "", ratio);
+			font_info_destroy (font);
+			font = regular;
+		}
 	}
+
+	draw->fonts[style] = font;
+	return font;
 }
 
 void
@@ -920,14 +1137,26 @@ _vte_draw_get_char_width (struct _vte_draw *draw, vteunistr c, int columns,
 
 	g_return_val_if_fail (draw->fonts[VTE_DRAW_NORMAL] != NULL, 0);
 
-	uinfo = font_info_get_unistr_info (draw->fonts[style], c);
+	uinfo = font_info_get_unistr_info (_vte_draw_get_font (draw, style), c);
 	return uinfo->width;
 }
 
 gboolean
 _vte_draw_has_bold (struct _vte_draw *draw, guint style)
 {
-	return (draw->fonts[style ^ VTE_DRAW_BOLD] != draw->fonts[style]);
+	return (_vte_draw_get_font (draw, style ^ VTE_DRAW_BOLD) !=
+		_vte_draw_get_font (draw, style));
+}
+
+/* Returns the number of characters that had to be shaped because they were
+ * not cached yet, and the total time spent doing so, in microseconds. */
+void
+_vte_draw_get_glyph_lookup_stats (guint *misses, gint64 *usecs)
+{
+	if (misses)
+		*misses = glyph_lookup_misses;
+	if (usecs)
+		*usecs = glyph_lookup_time;
 }
 
 /* Check if a unicode character is actually a graphic character we draw
@@ -944,7 +1173,7 @@ _vte_draw_unichar_is_local_graphic(vteunistr c)
 /* Draw the graphic representation of a line-drawing or special graphics
  * character. */
 static void
-_vte_draw_terminal_draw_graphic(struct _vte_draw *draw, vteunistr c, vte::color::rgb const* fg,
+_vte_draw_terminal_draw_graphic(cairo_t *cr, vteunistr c, vte::color::rgb const* fg,
                                 gint x, gint y,
                                 gint column_width, gint columns, gint row_height)
 {
@@ -952,7 +1181,6 @@ _vte_draw_terminal_draw_graphic(struct _vte_draw *draw, vteunistr c, vte::color:
         int upper_half, lower_half, left_half, right_half;
         int light_line_width, heavy_line_width;
         double adjust;
-        cairo_t *cr = draw->cr;
 
         cairo_save (cr);
 
@@ -1401,6 +1629,72 @@ _vte_draw_terminal_draw_graphic(struct _vte_draw *draw, vteunistr c, vte::color:
         cairo_restore(cr);
 }
 
+static void
+graphic_mask_free (gpointer data)
+{
+	struct graphic_mask *mask = (struct graphic_mask *) data;
+
+	cairo_surface_destroy (mask->surface);
+	g_slice_free (struct graphic_mask, mask);
+}
+
+/* Returns an alpha-only surface with the graphic for @c rendered at the
+ * given cell size, rendering it on first use. */
+static cairo_surface_t *
+_vte_draw_get_graphic_mask (struct _vte_draw *draw, vteunistr c, vte::color::rgb const* fg,
+                            gint column_width, gint columns, gint row_height)
+{
+	gpointer key = GUINT_TO_POINTER ((c - 0x2500) | ((guint) columns << 8));
+	struct graphic_mask *mask;
+	cairo_surface_t *target;
+	cairo_t *cr;
+	gint scale = 1;
+
+	target = cairo_get_target (draw->cr);
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 14, 0)
+	{
+		double x_scale, y_scale;
+		cairo_surface_get_device_scale (target, &x_scale, &y_scale);
+		scale = (gint) x_scale;
+	}
+#endif
+
+	if (draw->graphic_masks == NULL)
+		draw->graphic_masks = g_hash_table_new_full (NULL, NULL, NULL, graphic_mask_free);
+	if (scale != draw->graphic_masks_scale) {
+		g_hash_table_remove_all (draw->graphic_masks);
+		draw->graphic_masks_scale = scale;
+	}
+
+	mask = (struct graphic_mask *) g_hash_table_lookup (draw->graphic_masks, key);
+	if (G_LIKELY (mask != NULL &&
+		      mask->column_width == column_width &&
+		      mask->row_height == row_height))
+		return mask->surface;
+
+	_vte_debug_print (VTE_DEBUG_DRAW, "Rendering graphic U+%04X (%dx%d, %d columns)\n",
+			  c, column_width, row_height, columns);
+
+	mask = g_slice_new (struct graphic_mask);
+	mask->column_width = column_width;
+	mask->row_height = row_height;
+	/* The similar surface inherits the target's device scale, so the
+	 * graphic stays crisp on HiDPI screens. */
+	mask->surface = cairo_surface_create_similar (target, CAIRO_CONTENT_ALPHA,
+						      MAX (column_width * columns, 1),
+						      MAX (row_height, 1));
+
+	cr = cairo_create (mask->surface);
+	cairo_set_source_rgba (cr, 0., 0., 0., 1.);
+	cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+	_vte_draw_terminal_draw_graphic (cr, c, fg, 0, 0, column_width, columns, row_height);
+	cairo_destroy (cr);
+
+	g_hash_table_replace (draw->graphic_masks, key, mask);
+
+	return mask->surface;
+}
+
 static void
 _vte_draw_text_internal (struct _vte_draw *draw,
 			 struct _vte_draw_text_request *requests, gsize n_requests,
@@ -1410,9 +1704,10 @@ _vte_draw_text_internal (struct _vte_draw *draw,
 	cairo_scaled_font_t *last_scaled_font = NULL;
 	int n_cr_glyphs = 0;
 	cairo_glyph_t cr_glyphs[MAX_RUN_LENGTH];
-	struct font_info *font = draw->fonts[style];
+	struct font_info *font;
 
-	g_return_if_fail (font != NULL);
+	g_return_if_fail (draw->fonts[VTE_DRAW_NORMAL] != NULL);
+	font = _vte_draw_get_font (draw, style);
 
         g_assert(draw->cr);
 	_vte_draw_set_source_color_alpha (draw, color, alpha);
@@ -1422,16 +1717,21 @@ _vte_draw_text_internal (struct _vte_draw *draw,
 		vteunistr c = requests[i].c;
 		int x = requests[i].x;
 		int y = requests[i].y + font->ascent;
-		struct unistr_info *uinfo = font_info_get_unistr_info (font, c);
-		union unistr_font_info *ufi = &uinfo->ufi;
+		struct unistr_info *uinfo;
+		union unistr_font_info *ufi;
 
                 if (_vte_draw_unichar_is_local_graphic(c)) {
-                        _vte_draw_terminal_draw_graphic(draw, c, color,
-                                                        requests[i].x, requests[i].y,
-                                                        font->width, requests[i].columns, font->height);
+                        /* The source color is already set, just stamp the mask */
+                        cairo_mask_surface (draw->cr,
+                                            _vte_draw_get_graphic_mask (draw, c, color,
+                                                                        font->width, requests[i].columns, font->height),
+                                            requests[i].x, requests[i].y);
                         continue;
                 }
 
+		uinfo = font_info_get_unistr_info (font, c);
+		ufi = &uinfo->ufi;
+
 		switch (uinfo->coverage) {
 		default:
 		case COVERAGE_UNKNOWN:
@@ -1530,7 +1830,7 @@ _vte_draw_has_char (struct _vte_draw *draw, vteunistr c, guint style)
 
 	g_return_val_if_fail (draw->fonts[VTE_DRAW_NORMAL] != NULL, FALSE);
 
-	uinfo = font_info_get_unistr_info (draw->fonts[style], c);
+	uinfo = font_info_get_unistr_info (_vte_draw_get_font (draw, style), c);
 	return !uinfo->has_unknown_chars;
 }
 
@@ -1595,6 +1895,33 @@ _vte_draw_fill_rectangle (struct _vte_draw *draw,
 	cairo_fill (draw->cr);
 }
 
+/* Fills all of @rects with the same color as a single path, which saves
+ * the per-rectangle source and fill setup of _vte_draw_fill_rectangle(). */
+void
+_vte_draw_fill_rectangles (struct _vte_draw *draw,
+			   cairo_rectangle_int_t const* rects, gsize n_rects,
+			   vte::color::rgb const* color, double alpha)
+{
+	gsize i;
+
+        g_assert(draw->cr);
+
+	_vte_debug_print (VTE_DEBUG_DRAW,
+			"draw_fill_rectangles (%" G_GSIZE_FORMAT " rectangles, color=(%d,%d,%d,%.3f))\n",
+			n_rects,
+			color->red, color->green, color->blue,
+			alpha);
+
+	if (n_rects == 0)
+		return;
+
+	cairo_set_operator (draw->cr, CAIRO_OPERATOR_OVER);
+	for (i = 0; i < n_rects; i++)
+		cairo_rectangle (draw->cr, rects[i].x, rects[i].y, rects[i].width, rects[i].height);
+	_vte_draw_set_source_color_alpha (draw, color, alpha);
+	cairo_fill (draw->cr);
+}
+
 
 void
 _vte_draw_draw_line(struct _vte_draw *draw,
@@ -68,6 +68,7 @@ void _vte_draw_get_text_metrics(struct _vte_draw *draw,
 int _vte_draw_get_char_width(struct _vte_draw *draw, vteunistr c, int columns,
 			     guint style);
 gboolean _vte_draw_has_bold (struct _vte_draw *draw, guint style);
+void _vte_draw_get_glyph_lookup_stats(guint *misses, gint64 *usecs);
 
 void _vte_draw_text(struct _vte_draw *draw,
 		    struct _vte_draw_text_request *requests, gsize n_requests,
@@ -80,6 +81,9 @@ gboolean _vte_draw_has_char(struct _vte_draw *draw, vteunistr c, guint style);
 void _vte_draw_fill_rectangle(struct _vte_draw *draw,
 			      gint x, gint y, gint width, gint height,
 			      vte::color::rgb const* color, double alpha);
+void _vte_draw_fill_rectangles(struct _vte_draw *draw,
+			       cairo_rectangle_int_t const* rects, gsize n_rects,
+			       vte::color::rgb const* color, double alpha);
 void _vte_draw_draw_rectangle(struct _vte_draw *draw,
 			      gint x, gint y, gint width, gint height,
 			      vte::color::rgb const* color, double alpha);
@@ -472,12 +472,21 @@ vte_terminal_get_property (GObject *object,
                 case PROP_INPUT_ENABLED:
                         g_value_set_boolean (value, vte_terminal_get_input_enabled (terminal));
                         break;
+                case PROP_MAX_FRAME_RATE:
+                        g_value_set_uint (value, vte_terminal_get_max_frame_rate (terminal));
+                        break;
                 case PROP_MOUSE_POINTER_AUTOHIDE:
                         g_value_set_boolean (value, vte_terminal_get_mouse_autohide (terminal));
                         break;
+                case PROP_PROCESS_TIME_TARGET:
+                        g_value_set_uint (value, vte_terminal_get_process_time_target (terminal));
+                        break;
                 case PROP_PTY:
                         g_value_set_object (value, vte_terminal_get_pty(terminal));
                         break;
+                case PROP_RENDERING_SUSPENDED:
+                        g_value_set_boolean (value, vte_terminal_get_rendering_suspended (terminal));
+                        break;
                 case PROP_REWRAP_ON_RESIZE:
                         g_value_set_boolean (value, vte_terminal_get_rewrap_on_resize (terminal));
                         break;
@@ -561,12 +570,21 @@ vte_terminal_set_property (GObject *object,
                 case PROP_INPUT_ENABLED:
                         vte_terminal_set_input_enabled (terminal, g_value_get_boolean (value));
                         break;
+                case PROP_MAX_FRAME_RATE:
+                        vte_terminal_set_max_frame_rate (terminal, g_value_get_uint (value));
+                        break;
                 case PROP_MOUSE_POINTER_AUTOHIDE:
                         vte_terminal_set_mouse_autohide (terminal, g_value_get_boolean (value));
                         break;
+                case PROP_PROCESS_TIME_TARGET:
+                        vte_terminal_set_process_time_target (terminal, g_value_get_uint (value));
+                        break;
                 case PROP_PTY:
                         vte_terminal_set_pty (terminal, (VtePty *)g_value_get_object (value));
                         break;
+                case PROP_RENDERING_SUSPENDED:
+                        vte_terminal_set_rendering_suspended (terminal, g_value_get_boolean (value));
+                        break;
                 case PROP_REWRAP_ON_RESIZE:
                         vte_terminal_set_rewrap_on_resize (terminal, g_value_get_boolean (value));
                         break;
@@ -1412,6 +1430,22 @@ vte_terminal_class_init(VteTerminalClass *klass)
                                       TRUE,
                                       (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
 
+        /**
+         * VteTerminal:max-frame-rate:
+         *
+         * The maximum number of times per second the terminal redraws itself
+         * in response to output from its child, or 0 for no limit beyond the
+         * default one.  Output is still processed at full speed; only the
+         * redraws are coalesced.
+         *
+         * Since: 0.52
+         */
+        pspecs[PROP_MAX_FRAME_RATE] =
+                g_param_spec_uint ("max-frame-rate", NULL, NULL,
+                                   0, 1000,
+                                   0,
+                                   (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
+
         /**
          * VteTerminal:pointer-autohide:
          *
@@ -1424,6 +1458,22 @@ vte_terminal_class_init(VteTerminalClass *klass)
                                       FALSE,
                                       (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
 
+        /**
+         * VteTerminal:process-time-target:
+         *
+         * The time in milliseconds the terminal aims to spend processing output
+         * from its child in between updates of the display.  The amount of
+         * output read from the child is adjusted to the measured processing
+         * speed to meet this target.
+         *
+         * Since: 0.52
+         */
+        pspecs[PROP_PROCESS_TIME_TARGET] =
+                g_param_spec_uint ("process-time-target", NULL, NULL,
+                                   1, 1000,
+                                   VTE_MAX_PROCESS_TIME,
+                                   (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
+
         /**
          * VteTerminal:pty:
          *
@@ -1434,6 +1484,20 @@ vte_terminal_class_init(VteTerminalClass *klass)
                                      VTE_TYPE_PTY,
                                      (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
 
+        /**
+         * VteTerminal:rendering-suspended:
+         *
+         * Controls whether the terminal redraws itself in response to output
+         * from its child.  While rendering is suspended, output is still
+         * processed; the terminal is redrawn once when rendering is resumed.
+         *
+         * Since: 0.52
+         */
+        pspecs[PROP_RENDERING_SUSPENDED] =
+                g_param_spec_boolean ("rendering-suspended", NULL, NULL,
+                                      FALSE,
+                                      (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY));
+
         /**
          * VteTerminal:rewrap-on-resize:
          *
@@ -2901,6 +2965,69 @@ vte_terminal_get_text_range(VteTerminal *terminal,
         return (char*)g_string_free(text, FALSE);
 }
 
+static void
+text_attribute_run_clear(gpointer data)
+{
+        g_free(((VteTextAttributeRun*)data)->hyperlink);
+}
+
+/**
+ * vte_terminal_get_text_runs:
+ * @terminal: a #VteTerminal
+ * @start_row: first row to search for data
+ * @start_col: first column to search for data
+ * @end_row: last row to search for data
+ * @end_col: last column to search for data
+ * @runs: (out) (optional) (transfer full) (element-type Vte.TextAttributeRun): location
+ *   to store a new array of #VteTextAttributeRun, or %NULL
+ *
+ * Extracts the same text as vte_terminal_get_text_range(), but instead of a
+ * #VteCharAttributes for each byte, describes its attributes with one
+ * #VteTextAttributeRun for each stretch of text sharing the same rendition.
+ * This is much cheaper when extracting large amounts of text.
+ *
+ * Hyperlink targets are only filled in if #VteTerminal:allow-hyperlink is
+ * enabled.  Free @runs with g_array_unref(), which also frees the targets.
+ *
+ * Returns: (transfer full): a newly allocated text string, or %NULL.
+ *
+ * Since: 0.52
+ */
+char *
+vte_terminal_get_text_runs(VteTerminal *terminal,
+                           long start_row,
+                           long start_col,
+                           long end_row,
+                           long end_col,
+                           GArray **runs)
+{
+        if (runs)
+                *runs = nullptr;
+	g_return_val_if_fail(VTE_IS_TERMINAL(terminal), NULL);
+
+        GArray *array = nullptr;
+        if (runs) {
+                array = g_array_new(FALSE, FALSE, sizeof(VteTextAttributeRun));
+                g_array_set_clear_func(array, text_attribute_run_clear);
+        }
+
+        auto impl = IMPL(terminal);
+        auto text = impl->get_text_runs(start_row, start_col,
+                                        end_row, end_col,
+                                        false /* block */,
+                                        true /* wrap */,
+                                        true /* include trailing whitespace */,
+                                        array);
+        if (array)
+                impl->get_text_run_hyperlinks(array);
+        if (runs)
+                *runs = array;
+
+        if (text == nullptr)
+                return nullptr;
+        return (char*)g_string_free(text, FALSE);
+}
+
 /**
  * vte_terminal_reset:
  * @terminal: a #VteTerminal
@@ -3766,6 +3893,45 @@ vte_terminal_set_input_enabled (VteTerminal *terminal,
                 g_object_notify_by_pspec(G_OBJECT(terminal), pspecs[PROP_INPUT_ENABLED]);
 }
 
+/**
+ * vte_terminal_get_max_frame_rate:
+ * @terminal: a #VteTerminal
+ *
+ * Returns: the maximum frame rate set with vte_terminal_set_max_frame_rate(),
+ *   or 0 if there is no limit
+ *
+ * Since: 0.52
+ */
+guint
+vte_terminal_get_max_frame_rate(VteTerminal *terminal)
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), 0);
+        return IMPL(terminal)->m_max_frame_rate;
+}
+
+/**
+ * vte_terminal_set_max_frame_rate:
+ * @terminal: a #VteTerminal
+ * @fps: the maximum number of redraws per second, or 0 for no limit
+ *
+ * Limits how often the terminal redraws itself in response to output from its
+ * child, e.g. for terminals that are visible but not being looked at closely.
+ * Output is still processed as fast as it arrives, and the changes are drawn
+ * together in the next frame.
+ *
+ * Since: 0.52
+ */
+void
+vte_terminal_set_max_frame_rate(VteTerminal *terminal,
+                                guint fps)
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+        g_return_if_fail(fps <= 1000);
+
+        if (IMPL(terminal)->set_max_frame_rate(fps))
+                g_object_notify_by_pspec(G_OBJECT(terminal), pspecs[PROP_MAX_FRAME_RATE]);
+}
+
 /**
  * vte_terminal_get_mouse_autohide:
  * @terminal: a #VteTerminal
@@ -3803,6 +3969,133 @@ vte_terminal_set_mouse_autohide(VteTerminal *terminal, gboolean setting)
                 g_object_notify_by_pspec(G_OBJECT(terminal), pspecs[PROP_MOUSE_POINTER_AUTOHIDE]);
 }
 
+/**
+ * vte_terminal_get_process_time_target:
+ * @terminal: a #VteTerminal
+ *
+ * Returns: the processing time target in milliseconds, see
+ *   vte_terminal_set_process_time_target()
+ *
+ * Since: 0.52
+ */
+guint
+vte_terminal_get_process_time_target(VteTerminal *terminal)
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), 0);
+        return IMPL(terminal)->m_process_time_target;
+}
+
+/**
+ * vte_terminal_set_process_time_target:
+ * @terminal: a #VteTerminal
+ * @msec: the time in milliseconds, between 1 and 1000
+ *
+ * Sets how long the terminal aims to spend processing output from its child
+ * in between updates of the display.  Lower values keep the display more
+ * responsive under heavy output, at the cost of throughput.
+ *
+ * Since: 0.52
+ */
+void
+vte_terminal_set_process_time_target(VteTerminal *terminal,
+                                     guint msec)
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+        g_return_if_fail(msec >= 1 && msec <= 1000);
+
+        if (IMPL(terminal)->set_process_time_target(msec))
+                g_object_notify_by_pspec(G_OBJECT(terminal), pspecs[PROP_PROCESS_TIME_TARGET]);
+}
+
+/**
+ * vte_terminal_get_stats:
+ * @terminal: a #VteTerminal
+ *
+ * Returns internal state of @terminal that is useful when tuning it or
+ * diagnosing performance problems, as a dictionary of type a{sv}.  The set
+ * of keys is not stable and may change between versions; currently these
+ * include:
+ *
+ * - "process-time-target" (u): see vte_terminal_set_process_time_target()
+ * - "process-time-last" (d): milliseconds spent in the last processing pass
+ * - "process-rate-text", "process-rate-sequences" (d): moving averages of
+ *   the processing speed in bytes per millisecond of mostly textual and of
+ *   escape sequence heavy output, or 0 if not measured yet
+ * - "input-budget" (x): the number of bytes read from the child in between
+ *   processing passes
+ * - "input-arena-bytes" (t): memory held for buffering input from the child
+ * - "scrollback-buffer-bytes" (t): memory held for caching and collecting
+ *   the blocks of the on-disk scrollback; it is given back some seconds
+ *   after the terminal goes idle
+ *
+ * Returns: (transfer full): a new #GVariant
+ *
+ * Since: 0.52
+ */
+GVariant *
+vte_terminal_get_stats(VteTerminal *terminal)
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), NULL);
+        return g_variant_ref_sink(IMPL(terminal)->get_stats());
+}
+
+/**
+ * vte_terminal_flush_pending_signals:
+ * @terminal: a #VteTerminal
+ *
+ * Under heavy output, the signals and property notifications reporting
+ * changes to the terminal's contents, cursor and titles, as well as the
+ * updates of its vertical adjustment, are batched and emitted at most once
+ * per frame.  This emits any that are still pending right away, for callers
+ * that need the adjustment and the signals to reflect the output processed
+ * so far.  Only output that has already been processed is covered; data
+ * passed to vte_terminal_feed() is processed later, from the main loop.
+ *
+ * Since: 0.52
+ */
+void
+vte_terminal_flush_pending_signals(VteTerminal *terminal)
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+        IMPL(terminal)->emit_pending_signals();
+}
+
+/**
+ * vte_terminal_get_rendering_suspended:
+ * @terminal: a #VteTerminal
+ *
+ * Returns: %TRUE if rendering is suspended, %FALSE if not
+ *
+ * Since: 0.52
+ */
+gboolean
+vte_terminal_get_rendering_suspended(VteTerminal *terminal)
+{
+        g_return_val_if_fail(VTE_IS_TERMINAL(terminal), FALSE);
+        return IMPL(terminal)->m_rendering_suspended;
+}
+
+/**
+ * vte_terminal_set_rendering_suspended:
+ * @terminal: a #VteTerminal
+ * @suspended: whether to suspend rendering
+ *
+ * Suspends or resumes redrawing the terminal in response to output from its
+ * child.  While suspended, output keeps being processed but no damage is
+ * accumulated; resuming redraws the whole terminal once.
+ *
+ * Since: 0.52
+ */
+void
+vte_terminal_set_rendering_suspended(VteTerminal *terminal,
+                                     gboolean suspended)
+{
+        g_return_if_fail(VTE_IS_TERMINAL(terminal));
+
+        if (IMPL(terminal)->set_rendering_suspended(suspended != FALSE))
+                g_object_notify_by_pspec(G_OBJECT(terminal), pspecs[PROP_RENDERING_SUSPENDED]);
+}
+
 /**
  * vte_terminal_set_pty:
  * @terminal: a #VteTerminal
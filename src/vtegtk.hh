@@ -79,8 +79,11 @@ enum {
         PROP_HYPERLINK_HOVER_URI,
         PROP_ICON_TITLE,
         PROP_INPUT_ENABLED,
+        PROP_MAX_FRAME_RATE,
         PROP_MOUSE_POINTER_AUTOHIDE,
+        PROP_PROCESS_TIME_TARGET,
         PROP_PTY,
+        PROP_RENDERING_SUSPENDED,
         PROP_REWRAP_ON_RESIZE,
         PROP_SCROLLBACK_LINES,
         PROP_SCROLL_ON_KEYSTROKE,
@@ -83,6 +83,14 @@ typedef struct _VtePaletteColor {
 	} sources[2];
 } VtePaletteColor;
 
+/* The color a palette entry currently resolves to, plain and dimmed, so
+ * that drawing doesn't have to walk the color sources for every cell. */
+typedef struct _VteResolvedColor {
+        vte::color::rgb color;
+        vte::color::rgb dim;
+        bool is_set;
+} VteResolvedColor;
+
 /* These correspond to the parameters for DECSCUSR (Set cursor style). */
 typedef enum _VteCursorStyle {
         /* We treat 0 and 1 differently, assuming that the VT510 does so too.
@@ -114,6 +122,16 @@ struct _vte_incoming_chunk{
         guchar data[VTE_INPUT_CHUNK_SIZE - 2 * sizeof(void *) - 1];
 };
 
+/* Per-terminal allocator of incoming chunks, see get_chunk() */
+typedef struct _vte_incoming_arena _vte_incoming_arena_t;
+struct _vte_incoming_arena {
+        guchar *region;                      /* VTE_INPUT_ARENA_CHUNKS chunks, or nullptr */
+        _vte_incoming_chunk_t *free_chunks;  /* unused chunks of region */
+        guint n_region_used;                 /* chunks of region not on free_chunks */
+        guint n_heap_used;                   /* chunks allocated from the heap */
+        gsize buffered;                      /* bytes queued in m_incoming */
+};
+
 typedef struct _VteScreen VteScreen;
 struct _VteScreen {
         VteRing row_data[1];	/* buffer contents */
@@ -170,6 +188,42 @@ struct vte_scrolling_region {
         int start, end;
 };
 
+/* A run of cells within a row that are drawn with the same style */
+struct vte_draw_run {
+        vte::grid::row_t row;
+        vte::grid::column_t start, end;  /* [start, end) */
+        guint fore, back;                /* resolved colors, see determine_colors() */
+        guint bold : 1;
+        guint italic : 1;
+        guint underline : 1;
+        guint strikethrough : 1;
+        guint hyperlink : 1;
+        guint hilite : 1;
+};
+
+/* Accumulated time spent in the phases of draw_rows(), in microseconds.
+ * Only collected while m_draw_timings_enabled is set; see drawbench.cc. */
+struct vte_draw_timings {
+        gint64 runs;                     /* resolving rows into style runs */
+        gint64 background;
+        gint64 text;
+        gint64 decorations;
+};
+
+/* Classes of input that process at very different rates, see
+ * time_process_incoming(). */
+typedef enum _VteContentClass {
+        VTE_CONTENT_CLASS_TEXT,
+        VTE_CONTENT_CLASS_SEQUENCES,      /* dense in escape sequences, e.g. SGR heavy */
+        VTE_CONTENT_CLASS_COUNT
+} VteContentClass;
+
+/* A rectangle queued for filling, see queue_fill_rectangle() */
+struct vte_draw_fill_rect {
+        guint color;                     /* see determine_colors() */
+        cairo_rectangle_int_t rect;
+};
+
 template <class T>
 class ClipboardTextRequestGtk {
 public:
@@ -273,6 +327,13 @@ public:
         vte::grid::row_t m_row_count;
         vte::grid::column_t m_column_count;
 
+        /* Interactive resize coalescing, see widget_size_allocate() */
+        vte::grid::column_t m_rewrapped_column_count; /* width the normal screen is wrapped to */
+        gint64 m_last_resize_time;
+        gint64 m_last_winsize_time;
+        guint m_resize_settle_tag;
+        bool m_winsize_pending;
+
 	/* Emulation setup data. */
         struct _vte_matcher *m_matcher;   /* control sequence matcher */
         gboolean m_autowrap;              /* auto wraparound at right margin */
@@ -293,14 +354,28 @@ public:
         const char *m_encoding;            /* the pty's encoding */
         int m_utf8_ambiguous_width;
         struct _vte_iso2022_state *m_iso2022;
-        _vte_incoming_chunk_t *m_incoming; /* pending bytestream */
+        _vte_incoming_chunk_t *m_incoming; /* pending bytestream, oldest chunk first */
+        _vte_incoming_chunk_t *m_incoming_tail;
+        _vte_incoming_arena_t m_incoming_arena;
+        guint m_idle_trim_tag;
+        gulong m_idle_trim_stream_reads;   /* scrollback reads as of scheduling the trim */
         GArray *m_pending;                 /* pending characters */
+        guint m_pending_start;             /* already processed characters at the front of m_pending */
+        long m_string_scanned;             /* chars of a partial string sequence in m_pending known to be unterminated */
+        bool m_string_discarding;          /* dropping the rest of an overlong string sequence */
         gunichar m_last_graphic_character; /* for REP */
         /* Array of dirty rectangles in view coordinates; need to
          * add allocation origin and padding when passing to gtk.
          */
         GArray *m_update_rects;
         gboolean m_invalidated_all;       /* pending refresh of entire terminal */
+        /* Scratch array of vte_draw_run for draw_rows() */
+        GArray *m_draw_runs;
+        /* Array of vte_draw_fill_rect waiting for flush_fill_rectangles() */
+        GArray *m_draw_fill_rects;
+        bool m_draw_batch_fills;
+        struct vte_draw_timings m_draw_timings;
+        bool m_draw_timings_enabled;
         /* If non-nullptr, contains the GList element for @this in g_active_terminals
          * and means that this terminal is processing data.
          */
@@ -308,6 +383,11 @@ public:
         // FIXMEchpe should these two be g[s]size ?
         glong m_input_bytes;
         glong m_max_input_bytes;
+        /* Input budget controller, see time_process_incoming() */
+        guint m_process_time_target;     /* ms of processing per update */
+        double m_process_rate[VTE_CONTENT_CLASS_COUNT]; /* moving average of bytes/ms, 0 if unknown */
+        VteContentClass m_process_class; /* of the most recently processed input */
+        double m_process_last_time;      /* ms */
 
 	/* Output data queue. */
         VteByteArray *m_outgoing; /* pending input characters */
@@ -398,7 +478,8 @@ public:
 	/* Cursor blinking, as set in dconf. */
         VteCursorBlinkMode m_cursor_blink_mode;
         gboolean m_cursor_blink_state;
-        guint m_cursor_blink_tag;           /* cursor blinking timeout ID */
+        GList *m_cursor_blink_link;         /* link in the list of blinking terminals */
+        gint64 m_cursor_blink_next;         /* monotonic time of the next blink */
         gint m_cursor_blink_cycle;          /* gtk-cursor-blink-time / 2 */
         gint m_cursor_blink_timeout;        /* gtk-cursor-blink-timeout */
         gboolean m_cursor_blinks;           /* whether the cursor is actually blinking */
@@ -423,6 +504,15 @@ public:
          * the viewable area.
          */
         vte::view::coords m_mouse_last_position;
+        /* Where hyperlinks and matches were last hilited for */
+        vte::view::coords m_mouse_hilite_position;
+        /* The cell of the last pointer event, for dropping same-cell
+         * motion reports in cell motion tracking mode */
+        vte::grid::coords m_mouse_drag_rowcol;
+        /* Motion is handled once per frame, for the latest position */
+        guint m_motion_tick_id;
+        bool m_motion_hilite_pending;
+        bool m_motion_drag_pending;
         gboolean m_mouse_autohide;
         guint m_mouse_autoscroll_tag;
         gboolean m_mouse_xterm_extension;
@@ -471,6 +561,7 @@ public:
         struct _vte_draw *m_draw;
 
         VtePaletteColor m_palette[VTE_PALETTE_SIZE];
+        VteResolvedColor m_resolved_palette[VTE_PALETTE_SIZE];
 
 	/* Mouse cursors. */
         gboolean m_mouse_cursor_over_widget;
@@ -495,6 +586,8 @@ public:
         gboolean m_adjustment_value_changed_pending;
         gboolean m_cursor_moved_pending;
         gboolean m_contents_changed_pending;
+        gint64 m_last_signals_time;       /* when the pending signals were last emitted */
+        guint m_pending_signals_tag;      /* timeout emitting them at the end of the frame */
 
 	/* window name changes */
         char* m_window_title;
@@ -515,6 +608,11 @@ public:
 	/* Obscured? state. */
         GdkVisibilityState m_visibility_state;
 
+        /* Render throttling; processing continues while either is in effect */
+        bool m_rendering_suspended;
+        guint m_max_frame_rate;           /* 0 for no limit */
+        gint64 m_last_frame_time;         /* monotonic time of the last flush of m_update_rects */
+
 	/* Font stuff. */
         gboolean m_has_fonts;
         long m_line_thickness;
@@ -543,6 +641,9 @@ public:
                                        bool fill);
         /* inline */ VteRowData* ring_append(bool fill);
         /* inline */ void ring_remove(vte::grid::row_t position);
+        void ring_rotate(vte::grid::row_t start,
+                         vte::grid::row_t end,
+                         vte::grid::row_t count);
         inline VteRowData const* find_row_data(vte::grid::row_t row) const;
         inline VteRowData* find_row_data_writable(vte::grid::row_t row) const;
         inline VteCell const* find_charcell(vte::grid::column_t col,
@@ -587,9 +688,13 @@ public:
         void invalidate_selection();
         void invalidate_all();
 
+        inline bool rendering_inhibited() const;
         void reset_update_rects();
         bool invalidate_dirty_rects_and_process_updates();
         void time_process_incoming();
+        void update_input_budget();
+        bool set_process_time_target(guint msec);
+        GVariant* get_stats();
         void process_incoming();
         bool process(bool emit_adj_changed);
         inline bool is_processing() const { return m_active_terminals_link != nullptr; }
@@ -690,6 +795,17 @@ public:
         void paint_area(GdkRectangle const* area);
         void paint_cursor();
         void paint_im_preedit_string();
+        void queue_fill_rectangle(guint color,
+                                  int x,
+                                  int y,
+                                  int width,
+                                  int height);
+        void queue_line(guint color,
+                        int x,
+                        int y,
+                        int xp,
+                        int yp);
+        void flush_fill_rectangles();
         void draw_cells(struct _vte_draw_text_request *items,
                         gssize n,
                         guint fore,
@@ -720,6 +836,25 @@ public:
                                         bool draw_default_bg,
                                         int column_width,
                                         int height);
+        bool selection_columns_for_row(vte::grid::row_t row,
+                                       vte::grid::column_t *start,
+                                       vte::grid::column_t *end) const;
+        void append_draw_run(vte::grid::row_t row,
+                             vte::grid::column_t start,
+                             vte::grid::column_t end,
+                             VteCellAttr const* attr,
+                             bool selected,
+                             bool hyperlink,
+                             bool hilite);
+        void resolve_row_runs(VteRowData const* row_data,
+                              vte::grid::row_t row,
+                              vte::grid::column_t start_column,
+                              vte::grid::column_t end_column);
+        void draw_run_cells(struct _vte_draw_text_request *items,
+                            gssize n,
+                            struct vte_draw_run const* run,
+                            int column_width,
+                            int row_height);
         void draw_rows(VteScreen *screen,
                        vte::grid::row_t start_row,
                        long row_count,
@@ -754,6 +889,9 @@ public:
                           GIOCondition condition);
 
         void feed_chunks(struct _vte_incoming_chunk *chunks);
+        void release_incoming();
+        void schedule_idle_trim();
+        void maybe_schedule_idle_trim();
         void send_child(char const* data,
                         gssize length,
                         bool local_echo,
@@ -829,6 +967,16 @@ public:
                           bool include_trailing_spaces,
                           GArray* attributes = nullptr);
 
+        GString* get_text_runs(vte::grid::row_t start_row,
+                               vte::grid::column_t start_col,
+                               vte::grid::row_t end_row,
+                               vte::grid::column_t end_col,
+                               bool block,
+                               bool wrap,
+                               bool include_trailing_spaces,
+                               GArray* runs);
+        void get_text_run_hyperlinks(GArray* runs);
+
         GString* get_text_displayed(bool wrap,
                                     bool include_trailing_spaces,
                                     GArray* attributes = nullptr);
@@ -839,6 +987,8 @@ public:
 
         GString* get_selected_text(GArray* attributes = nullptr);
 
+        void update_resolved_color(int entry);
+        void update_resolved_palette();
         inline void rgb_from_index(guint index,
                                    vte::color::rgb& color) const;
         inline void determine_colors(VteCellAttr const* attr,
@@ -929,6 +1079,7 @@ public:
         void emit_text_modified();
         void emit_text_scrolled(long delta);
         void emit_pending_signals();
+        void queue_pending_signals();
         void emit_char_size_changed(int width,
                                     int height);
         void emit_increase_font_size();
@@ -957,6 +1108,9 @@ public:
         void hyperlink_invalidate_and_get_bbox(hyperlink_idx_t idx, GdkRectangle *bbox);
         void hyperlink_hilite_update(vte::view::coords const& pos);
         void hyperlink_hilite(vte::view::coords const& pos);
+        void hilite_hover(vte::view::coords const& pos);
+        void queue_motion();
+        void flush_motion();
 
         void match_contents_clear();
         void match_contents_refresh();
@@ -1058,6 +1212,10 @@ public:
 
         void set_size(long columns,
                       long rows);
+        bool apply_size(long columns,
+                        long rows,
+                        bool settling);
+        void finish_resize();
 
         bool process_word_char_exceptions(char const *str,
                                           gunichar **arrayp,
@@ -1104,6 +1262,8 @@ public:
         bool set_font_desc(PangoFontDescription const* desc);
         bool set_font_scale(double scale);
         bool set_input_enabled(bool enabled);
+        bool set_max_frame_rate(guint fps);
+        bool set_rendering_suspended(bool suspended);
         bool set_mouse_autohide(bool autohide);
         bool set_pty(VtePty *pty);
         bool set_rewrap_on_resize(bool rewrap);
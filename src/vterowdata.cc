@@ -79,8 +79,12 @@ void
 _vte_row_data_clear (VteRowData *row)
 {
 	VteCell *cells = row->cells;
+        VteHyperlinkSpan *hyperlinks = row->hyperlinks;
+        guint16 hyperlinks_alloc_len = row->hyperlinks_alloc_len;
 	_vte_row_data_init (row);
 	row->cells = cells;
+        row->hyperlinks = hyperlinks;
+        row->hyperlinks_alloc_len = hyperlinks_alloc_len;
 }
 
 void
@@ -89,6 +93,10 @@ _vte_row_data_fini (VteRowData *row)
 	if (row->cells)
 		_vte_cells_free (_vte_cells_for_cell_array (row->cells));
 	row->cells = NULL;
+        g_free (row->hyperlinks);
+        row->hyperlinks = NULL;
+        row->n_hyperlinks = row->hyperlinks_alloc_len = 0;
+        row->hyperlinks_valid = 0;
 }
 
 static inline gboolean
@@ -119,6 +127,7 @@ _vte_row_data_insert (VteRowData *row, gulong col, const VteCell *cell)
 
 	row->cells[col] = *cell;
 	row->len++;
+        row->hyperlinks_valid = 0;
 }
 
 void _vte_row_data_append (VteRowData *row, const VteCell *cell)
@@ -128,6 +137,7 @@ void _vte_row_data_append (VteRowData *row, const VteCell *cell)
 
 	row->cells[row->len] = *cell;
 	row->len++;
+        row->hyperlinks_valid = 0;
 }
 
 void _vte_row_data_remove (VteRowData *row, gulong col)
@@ -139,6 +149,7 @@ void _vte_row_data_remove (VteRowData *row, gulong col)
 
 	if (G_LIKELY (row->len))
 		row->len--;
+        row->hyperlinks_valid = 0;
 }
 
 void _vte_row_data_fill (VteRowData *row, const VteCell *cell, gulong len)
@@ -153,12 +164,54 @@ void _vte_row_data_fill (VteRowData *row, const VteCell *cell, gulong len)
 			row->cells[i] = *cell;
 
 		row->len = len;
+                row->hyperlinks_valid = 0;
 	}
 }
 
 void _vte_row_data_shrink (VteRowData *row, gulong max_len)
 {
-	if (max_len < row->len)
+	if (max_len < row->len) {
 		row->len = max_len;
+                row->hyperlinks_valid = 0;
+        }
+}
+
+/*
+ * Returns the runs of hyperlinked cells of the row, in increasing column order.
+ *
+ * The index is rebuilt by a single pass over the cells the first time it's
+ * asked for after the row was modified, so that repeated lookups while hovering
+ * cost O(spans) instead of O(cells).  It's a cache, hence the const row.
+ */
+const VteHyperlinkSpan *
+_vte_row_data_get_hyperlinks (const VteRowData *const_row, gulong *n_spans)
+{
+        VteRowData *row = (VteRowData *) const_row;
+        gulong col, end;
+
+        if (G_UNLIKELY (!row->hyperlinks_valid)) {
+                row->n_hyperlinks = 0;
+                for (col = 0; col < row->len; col = end) {
+                        guint32 idx = row->cells[col].attr.hyperlink_idx;
+
+                        for (end = col + 1; end < row->len && row->cells[end].attr.hyperlink_idx == idx; end++)
+                                ;
+                        if (G_LIKELY (idx == 0))
+                                continue;
+
+                        if (row->n_hyperlinks == row->hyperlinks_alloc_len) {
+                                row->hyperlinks_alloc_len = MIN (0xFFFF, MAX (8, 2 * row->hyperlinks_alloc_len));
+                                row->hyperlinks = g_renew (VteHyperlinkSpan, row->hyperlinks, row->hyperlinks_alloc_len);
+                        }
+                        row->hyperlinks[row->n_hyperlinks].start = col;
+                        row->hyperlinks[row->n_hyperlinks].end = end - 1;
+                        row->hyperlinks[row->n_hyperlinks].idx = idx;
+                        row->n_hyperlinks++;
+                }
+                row->hyperlinks_valid = 1;
+        }
+
+        *n_spans = row->n_hyperlinks;
+        return row->hyperlinks;
 }
 
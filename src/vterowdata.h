@@ -139,6 +139,15 @@ typedef struct _VteRowAttr {
 } VteRowAttr;
 G_STATIC_ASSERT (sizeof (VteRowAttr) == 1);
 
+/*
+ * VteHyperlinkSpan: A run of adjacent cells sharing the same nonzero hyperlink idx
+ */
+
+typedef struct _VteHyperlinkSpan {
+        guint16 start, end;     /* first and last column, inclusive */
+        guint32 idx;
+} VteHyperlinkSpan;
+
 /*
  * VteRowData: A single row's data
  */
@@ -147,6 +156,9 @@ typedef struct _VteRowData {
 	VteCell *cells;
 	guint16 len;
 	VteRowAttr attr;
+        guint8 hyperlinks_valid: 1;     /* hyperlinks matches cells */
+        guint16 n_hyperlinks, hyperlinks_alloc_len;
+        VteHyperlinkSpan *hyperlinks;   /* span index, rebuilt on demand after the cells change */
 } VteRowData;
 
 
@@ -167,6 +179,7 @@ _vte_row_data_get_writable (VteRowData *row, gulong col)
 	if (G_UNLIKELY (row->len <= col))
 		return NULL;
 
+        row->hyperlinks_valid = 0;
 	return &row->cells[col];
 }
 
@@ -187,6 +200,7 @@ void _vte_row_data_append (VteRowData *row, const VteCell *cell);
 void _vte_row_data_remove (VteRowData *row, gulong col);
 void _vte_row_data_fill (VteRowData *row, const VteCell *cell, gulong len);
 void _vte_row_data_shrink (VteRowData *row, gulong max_len);
+const VteHyperlinkSpan *_vte_row_data_get_hyperlinks (const VteRowData *row, gulong *n_spans);
 
 
 G_END_DECLS
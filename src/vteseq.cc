@@ -317,20 +317,7 @@ VteTerminalPrivate::seq_scroll_text(vte::grid::row_t scroll_amount)
                 end = start + m_row_count - 1;
 	}
 
-        while (_vte_ring_next(m_screen->row_data) <= end)
-                ring_append(false);
-
-	if (scroll_amount > 0) {
-		for (auto i = 0; i < scroll_amount; i++) {
-                        ring_remove(end);
-                        ring_insert(start, true);
-		}
-	} else {
-		for (auto i = 0; i < -scroll_amount; i++) {
-                        ring_remove(start);
-                        ring_insert(end, true);
-		}
-	}
+        ring_rotate(start, end, scroll_amount);
 
 	/* Update the display. */
         scroll_region(start, end - start + 1, scroll_amount);
@@ -1875,8 +1862,7 @@ VteTerminalPrivate::seq_reverse_index()
         if (m_screen->cursor.row == start) {
 		/* If we're at the top of the scrolling region, add a
 		 * line at the top to scroll the bottom off. */
-		ring_remove(end);
-		ring_insert(start, true);
+		ring_rotate(start, end, 1);
 		/* Update the display. */
 		scroll_region(start, end - start + 1, 1);
                 invalidate_cells(0, m_column_count,
@@ -2839,7 +2825,7 @@ vte_sequence_handler_insert_lines (VteTerminalPrivate *that, GValueArray *params
 void
 VteTerminalPrivate::seq_insert_lines(vte::grid::row_t param)
 {
-        vte::grid::row_t end, i;
+        vte::grid::row_t end;
 
 	/* Find the region we're messing with. */
         auto row = m_screen->cursor.row;
@@ -2855,12 +2841,10 @@ VteTerminalPrivate::seq_insert_lines(vte::grid::row_t param)
         auto limit = end - row + 1;
         param = MIN (param, limit);
 
-	for (i = 0; i < param; i++) {
-		/* Clear a line off the end of the region and add one to the
-		 * top of the region. */
-                ring_remove(end);
-                ring_insert(row, true);
-	}
+	/* Clear lines off the end of the region and add them to the
+	 * top of the region. */
+        if (param > 0)
+                ring_rotate(row, end, param);
         m_screen->cursor.col = 0;
 	/* Update the display. */
         scroll_region(row, end - row + 1, param);
@@ -2890,7 +2874,7 @@ vte_sequence_handler_delete_lines (VteTerminalPrivate *that, GValueArray *params
 void
 VteTerminalPrivate::seq_delete_lines(vte::grid::row_t param)
 {
-        vte::grid::row_t end, i;
+        vte::grid::row_t end;
 
 	/* Find the region we're messing with. */
         auto row = m_screen->cursor.row;
@@ -2906,13 +2890,10 @@ VteTerminalPrivate::seq_delete_lines(vte::grid::row_t param)
         auto limit = end - row + 1;
         param = MIN (param, limit);
 
-	/* Clear them from below the current cursor. */
-	for (i = 0; i < param; i++) {
-		/* Insert a line at the end of the region and remove one from
-		 * the top of the region. */
-                ring_remove(row);
-                ring_insert(end, true);
-	}
+	/* Clear them from below the current cursor: insert lines at the
+	 * end of the region and remove them from the top of the region. */
+        if (param > 0)
+                ring_rotate(row, end, -param);
         m_screen->cursor.col = 0;
 	/* Update the display. */
         scroll_region(row, end - row + 1, -param);
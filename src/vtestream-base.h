@@ -31,6 +31,11 @@ struct _VteStream {
 	GObject parent;
 };
 
+struct _VteStreamReader {
+	VteStream *stream;
+	gsize tail, head;
+};
+
 typedef struct _VteStreamClass {
 	GObjectClass parent_class;
 
@@ -41,6 +46,11 @@ typedef struct _VteStreamClass {
 	void (*advance_tail) (VteStream *stream, gsize offset);
 	gsize (*tail) (VteStream *stream);
 	gsize (*head) (VteStream *stream);
+	void (*trim) (VteStream *stream);
+	gsize (*buffer_size) (VteStream *stream);
+	VteStreamReader *(*reader_new) (VteStream *stream);
+	void (*reader_free) (VteStreamReader *reader);
+	gboolean (*reader_read) (VteStreamReader *reader, gsize offset, char *data, gsize len);
 } VteStreamClass;
 
 static GType _vte_stream_get_type (void);
@@ -101,5 +111,48 @@ _vte_stream_head (VteStream *stream)
 	return VTE_STREAM_GET_CLASS (stream)->head (stream);
 }
 
+/* Releases the memory that's only there to speed things up */
+void
+_vte_stream_trim (VteStream *stream)
+{
+	VTE_STREAM_GET_CLASS (stream)->trim (stream);
+}
+
+gsize
+_vte_stream_get_buffer_size (VteStream *stream)
+{
+	return VTE_STREAM_GET_CLASS (stream)->buffer_size (stream);
+}
+
+VteStreamReader *
+_vte_stream_reader_new (VteStream *stream)
+{
+	return VTE_STREAM_GET_CLASS (stream)->reader_new (stream);
+}
+
+void
+_vte_stream_reader_free (VteStreamReader *reader)
+{
+	VTE_STREAM_GET_CLASS (reader->stream)->reader_free (reader);
+}
+
+gboolean
+_vte_stream_reader_read (VteStreamReader *reader, gsize offset, char *data, gsize len)
+{
+	return VTE_STREAM_GET_CLASS (reader->stream)->reader_read (reader, offset, data, len);
+}
+
+gsize
+_vte_stream_reader_tail (VteStreamReader *reader)
+{
+	return reader->tail;
+}
+
+gsize
+_vte_stream_reader_head (VteStreamReader *reader)
+{
+	return reader->head;
+}
+
 G_END_DECLS
 
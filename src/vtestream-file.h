@@ -72,6 +72,15 @@
  *   decrypting and uncompressing possibly more underlying blocks, and sped up
  *   by caching the result.
  *
+ *   Complete blocks are handed to a pool of worker threads, so that the
+ *   compression, encryption and disk write don't hold up the main thread.
+ *   Each stream has at most one block in flight; any other operation on
+ *   the lower layers waits for it first, so they are never used from two
+ *   threads at a time.
+ *
+ *   The buffers are only allocated when needed, and trimming the stream
+ *   frees them, keeping just a copy of the partial block that's collected.
+ *
  * Design discussions: https://bugzilla.gnome.org/show_bug.cgi?id=738601
  */
 
@@ -1044,12 +1053,47 @@ typedef struct _VteFileStream {
          * to denote if no record is cached. */
         gsize rbuf_offset;
 
+        /* The partial block being collected. If wbuf_compact, the buffer
+         * is only wbuf_len bytes large, or NULL if that's 0. */
         char *wbuf;
         gsize wbuf_len;
+        gboolean wbuf_compact;
+
+        /* The last complete block, which a worker thread is writing to the
+         * boa while write_pending is set. Afterwards it stays around as a
+         * second read cache until the next block is complete.
+         * pbuf_offset is 1 if it doesn't hold a valid block. */
+        char *pbuf;
+        gsize pbuf_offset;
+        gboolean write_pending;
+
+        /* Serializes the use of the boa, see _vte_file_stream_lock() */
+        GMutex lock;
+        GCond write_cond;
+
+        /* Protects the readers list only, without waiting for the block
+         * in flight. May be taken while holding lock, not the other way. */
+        GMutex readers_lock;
+        GSList *readers;
 
         gsize head, tail;
 } VteFileStream;
 
+typedef struct _VteFileStreamReader {
+        VteStreamReader parent;
+
+        /* Blocks from here on may have been overwritten since the reader
+         * was created. Protected by the stream's lock. */
+        gsize disk_end;
+
+        /* Copy of the data that wasn't handed to the boa yet, starting at
+         * ALIGN_BOA(parent.head) */
+        char *wbuf;
+
+        char *rbuf;
+        gsize rbuf_offset;
+} VteFileStreamReader;
+
 typedef VteStreamClass VteFileStreamClass;
 
 static GType _vte_file_stream_get_type (void);
@@ -1063,14 +1107,111 @@ _vte_file_stream_new (void)
 	return (VteStream *) g_object_new (VTE_TYPE_FILE_STREAM, NULL);
 }
 
+static GThreadPool *_vte_file_stream_writer_pool = NULL;
+/* Write complete blocks synchronously instead, for unit testing */
+static gboolean _vte_file_stream_write_in_background = TRUE;
+
+#ifdef VTESTREAM_MAIN
+/* Lets the unit test hold back the worker, to keep a block in flight */
+static GMutex _vte_file_stream_test_gate_lock;
+static GCond _vte_file_stream_test_gate_cond;
+static gboolean _vte_file_stream_test_gate_closed = FALSE;
+#endif
+
 static void
 _vte_file_stream_init (VteFileStream *stream)
 {
         stream->boa = (VteBoa *)g_object_new (VTE_TYPE_BOA, NULL);
 
-        stream->rbuf = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
-        stream->wbuf = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
+        stream->wbuf_compact = TRUE;
         stream->rbuf_offset = 1;  /* Invalidate */
+        stream->pbuf_offset = 1;  /* Invalidate */
+        g_mutex_init (&stream->lock);
+        g_cond_init (&stream->write_cond);
+        g_mutex_init (&stream->readers_lock);
+}
+
+/* Takes the lock that is needed to use the boa, once the block in flight, if any, is written. */
+static void
+_vte_file_stream_lock (VteFileStream *stream)
+{
+        g_mutex_lock (&stream->lock);
+        while (stream->write_pending)
+                g_cond_wait (&stream->write_cond, &stream->lock);
+}
+
+static inline void
+_vte_file_stream_unlock (VteFileStream *stream)
+{
+        g_mutex_unlock (&stream->lock);
+}
+
+/* Makes the write buffer a whole block large again. */
+static void
+_vte_file_stream_ensure_wbuf (VteFileStream *stream)
+{
+        char *buf;
+
+        if (G_LIKELY (!stream->wbuf_compact))
+                return;
+
+        buf = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
+        if (stream->wbuf_len != 0)
+                memcpy(buf, stream->wbuf, stream->wbuf_len);
+        g_free(stream->wbuf);
+        stream->wbuf = buf;
+        stream->wbuf_compact = FALSE;
+}
+
+/* Runs in a worker thread. */
+static void
+_vte_file_stream_write_func (gpointer data, gpointer user_data)
+{
+        VteFileStream *stream = (VteFileStream *) data;
+
+#ifdef VTESTREAM_MAIN
+        g_mutex_lock (&_vte_file_stream_test_gate_lock);
+        while (_vte_file_stream_test_gate_closed)
+                g_cond_wait (&_vte_file_stream_test_gate_cond, &_vte_file_stream_test_gate_lock);
+        g_mutex_unlock (&_vte_file_stream_test_gate_lock);
+#endif
+
+        g_mutex_lock (&stream->lock);
+        _vte_boa_write (stream->boa, stream->pbuf_offset, stream->pbuf);
+        stream->write_pending = FALSE;
+        g_cond_broadcast (&stream->write_cond);
+        g_mutex_unlock (&stream->lock);
+}
+
+/* Write out the complete block in the write buffer, which starts at ALIGN_BOA(stream->head). */
+static void
+_vte_file_stream_write_block (VteFileStream *stream)
+{
+        char *buf;
+
+        if (G_UNLIKELY (!_vte_file_stream_write_in_background)) {
+                _vte_file_stream_lock (stream);
+                _vte_boa_write (stream->boa, ALIGN_BOA(stream->head), stream->wbuf);
+                _vte_file_stream_unlock (stream);
+                return;
+        }
+
+        _vte_file_stream_lock (stream);
+
+        if (stream->pbuf == NULL)
+                stream->pbuf = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
+        buf = stream->pbuf;
+        stream->pbuf = stream->wbuf;
+        stream->wbuf = buf;
+        stream->pbuf_offset = ALIGN_BOA(stream->head);
+        stream->write_pending = TRUE;
+
+        _vte_file_stream_unlock (stream);
+
+        if (_vte_file_stream_writer_pool == NULL)
+                _vte_file_stream_writer_pool = g_thread_pool_new (_vte_file_stream_write_func, NULL,
+                                                                  g_get_num_processors(), FALSE, NULL);
+        g_thread_pool_push (_vte_file_stream_writer_pool, stream, NULL);
 }
 
 static void
@@ -1078,8 +1219,16 @@ _vte_file_stream_finalize (GObject *object)
 {
         VteFileStream *stream = (VteFileStream *) object;
 
+        /* Readers hold a reference, so there are none left by now */
+        _vte_file_stream_lock (stream);
+        _vte_file_stream_unlock (stream);
+        g_mutex_clear (&stream->lock);
+        g_cond_clear (&stream->write_cond);
+        g_mutex_clear (&stream->readers_lock);
+
         g_free(stream->rbuf);
         g_free(stream->wbuf);
+        g_free(stream->pbuf);
         g_object_unref (stream->boa);
 
         G_OBJECT_CLASS (_vte_file_stream_parent_class)->finalize(object);
@@ -1090,26 +1239,39 @@ _vte_file_stream_reset (VteStream *astream, gsize offset)
 {
 	VteFileStream *stream = (VteFileStream *) astream;
         gsize offset_aligned = ALIGN_BOA(offset);
+        GSList *l;
 
         /* This is the same assertion as in boa, repeated here for the buffering layer
          * to catch if this expectation is broken within a block. */
         g_assert_cmpuint (offset, >=, stream->head);
 
+        _vte_file_stream_lock (stream);
         _vte_boa_reset (stream->boa, offset_aligned);
+        /* The boa has forgotten everything that the readers pinned */
+        g_mutex_lock (&stream->readers_lock);
+        for (l = stream->readers; l != NULL; l = l->next)
+                ((VteFileStreamReader *) l->data)->disk_end = 0;
+        g_mutex_unlock (&stream->readers_lock);
+        _vte_file_stream_unlock (stream);
         stream->tail = stream->head = offset;
 
         /* When resetting at a non-aligned offset, initial bytes of the write buffer
          * will eventually be written to disk, although doesn't contain useful information.
          * Rather than leaving garbage there, fill it with zeros.
          * For unit testing, fill it with dashes for convenience. */
+        if (MOD_BOA(offset) != 0) {
+                stream->wbuf_len = 0;
+                _vte_file_stream_ensure_wbuf (stream);
 #ifndef VTESTREAM_MAIN
-        memset(stream->wbuf, 0, MOD_BOA(offset));
+                memset(stream->wbuf, 0, MOD_BOA(offset));
 #else
-        memset(stream->wbuf, '-', MOD_BOA(offset));
+                memset(stream->wbuf, '-', MOD_BOA(offset));
 #endif
+        }
 
         stream->wbuf_len = MOD_BOA(offset);
         stream->rbuf_offset = 1;  /* Invalidate */
+        stream->pbuf_offset = 1;  /* Invalidate */
 }
 
 static gboolean
@@ -1135,12 +1297,24 @@ _vte_file_stream_read (VteStream *astream, gsize offset, char *data, gsize len)
         while (len && offset < ALIGN_BOA(stream->head)) {
                 gsize l = MIN(VTE_BOA_BLOCKSIZE - MOD_BOA(offset), len);
                 gsize offset_aligned = ALIGN_BOA(offset);
-                if (offset_aligned != stream->rbuf_offset) {
-                        if (G_UNLIKELY (!_vte_boa_read (stream->boa, offset_aligned, stream->rbuf)))
+                const char *buf;
+                if (offset_aligned == stream->pbuf_offset) {
+                        buf = stream->pbuf;
+                } else if (offset_aligned == stream->rbuf_offset) {
+                        buf = stream->rbuf;
+                } else {
+                        gboolean ok;
+                        if (stream->rbuf == NULL)
+                                stream->rbuf = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
+                        buf = stream->rbuf;
+                        _vte_file_stream_lock (stream);
+                        ok = _vte_boa_read (stream->boa, offset_aligned, stream->rbuf);
+                        _vte_file_stream_unlock (stream);
+                        if (G_UNLIKELY (!ok))
                                 return FALSE;
                         stream->rbuf_offset = offset_aligned;
                 }
-                memcpy(data, stream->rbuf + MOD_BOA(offset), l);
+                memcpy(data, buf + MOD_BOA(offset), l);
                 offset += l; data += l; len -= l;
         }
         if (len) {
@@ -1155,12 +1329,15 @@ _vte_file_stream_append (VteStream *astream, const char *data, gsize len)
 {
 	VteFileStream *stream = (VteFileStream *) astream;
 
+        if (len)
+                _vte_file_stream_ensure_wbuf (stream);
+
         while (len) {
                 gsize l = MIN(VTE_BOA_BLOCKSIZE - stream->wbuf_len, len);
                 memcpy(stream->wbuf + stream->wbuf_len, data, l);
                 stream->wbuf_len += l; data += l; len -= l;
                 if (stream->wbuf_len == VTE_BOA_BLOCKSIZE) {
-                        _vte_boa_write (stream->boa, ALIGN_BOA(stream->head), stream->wbuf);
+                        _vte_file_stream_write_block (stream);
                         stream->wbuf_len = 0;
                 }
                 stream->head += l;
@@ -1183,14 +1360,28 @@ _vte_file_stream_truncate (VteStream *astream, gsize offset)
                  * intact, that is, read back the new partial last block to
                  * the write cache. */
                 gsize offset_aligned = ALIGN_BOA(offset);
+                GSList *l;
+                _vte_file_stream_ensure_wbuf (stream);
+                _vte_file_stream_lock (stream);
                 if (G_UNLIKELY (!_vte_boa_read (stream->boa, offset_aligned, stream->wbuf))) {
                         /* what now? */
                         memset(stream->wbuf, 0, VTE_BOA_BLOCKSIZE);
                 }
+                /* The blocks from here on are going to be overwritten */
+                g_mutex_lock (&stream->readers_lock);
+                for (l = stream->readers; l != NULL; l = l->next) {
+                        VteFileStreamReader *reader = (VteFileStreamReader *) l->data;
+                        reader->disk_end = MIN(reader->disk_end, offset_aligned);
+                }
+                g_mutex_unlock (&stream->readers_lock);
+                _vte_file_stream_unlock (stream);
 
                 if (stream->rbuf_offset >= offset_aligned) {
                         stream->rbuf_offset = 1;  /* Invalidate */
                 }
+                if (stream->pbuf_offset >= offset_aligned) {
+                        stream->pbuf_offset = 1;  /* Invalidate */
+                }
         }
         stream->wbuf_len = MOD_BOA(offset);
 	stream->head = offset;
@@ -1200,12 +1391,28 @@ static void
 _vte_file_stream_advance_tail (VteStream *astream, gsize offset)
 {
 	VteFileStream *stream = (VteFileStream *) astream;
+        gsize boa_tail;
+        GSList *l;
 
         g_assert_cmpuint (offset, >=, stream->tail);
         g_assert_cmpuint (offset, <=, stream->head);
 
-        if (ALIGN_BOA(offset) > ALIGN_BOA(stream->tail))
-                _vte_boa_advance_tail (stream->boa, ALIGN_BOA(offset));
+        if (ALIGN_BOA(offset) > ALIGN_BOA(stream->tail)) {
+                /* Keep the blocks that readers still need */
+                boa_tail = ALIGN_BOA(offset);
+                g_mutex_lock (&stream->readers_lock);
+                for (l = stream->readers; l != NULL; l = l->next)
+                        boa_tail = MIN(boa_tail, ALIGN_BOA(((VteStreamReader *) l->data)->tail));
+                g_mutex_unlock (&stream->readers_lock);
+
+                /* Only this thread moves the boa's tail, so it can be
+                 * looked at without waiting for the block in flight */
+                if (boa_tail > _vte_boa_tail (stream->boa)) {
+                        _vte_file_stream_lock (stream);
+                        _vte_boa_advance_tail (stream->boa, boa_tail);
+                        _vte_file_stream_unlock (stream);
+                }
+        }
 
         stream->tail = offset;
 }
@@ -1226,6 +1433,110 @@ _vte_file_stream_head (VteStream *astream)
 	return stream->head;
 }
 
+static void
+_vte_file_stream_trim (VteStream *astream)
+{
+	VteFileStream *stream = (VteFileStream *) astream;
+
+        /* The block in flight needs to be written first */
+        _vte_file_stream_lock (stream);
+        g_free(stream->pbuf);
+        stream->pbuf = NULL;
+        stream->pbuf_offset = 1;  /* Invalidate */
+        _vte_file_stream_unlock (stream);
+
+        g_free(stream->rbuf);
+        stream->rbuf = NULL;
+        stream->rbuf_offset = 1;  /* Invalidate */
+
+        if (!stream->wbuf_compact) {
+                char *buf = stream->wbuf_len != 0 ? (char *) g_memdup (stream->wbuf, stream->wbuf_len) : NULL;
+                g_free(stream->wbuf);
+                stream->wbuf = buf;
+                stream->wbuf_compact = TRUE;
+        }
+}
+
+static gsize
+_vte_file_stream_buffer_size (VteStream *astream)
+{
+	VteFileStream *stream = (VteFileStream *) astream;
+
+        return (stream->rbuf != NULL ? VTE_BOA_BLOCKSIZE : 0) +
+               (stream->pbuf != NULL ? VTE_BOA_BLOCKSIZE : 0) +
+               (stream->wbuf_compact ? stream->wbuf_len : VTE_BOA_BLOCKSIZE);
+}
+
+static VteStreamReader *
+_vte_file_stream_reader_new (VteStream *astream)
+{
+	VteFileStream *stream = (VteFileStream *) astream;
+        VteFileStreamReader *reader = g_new0 (VteFileStreamReader, 1);
+
+        reader->parent.stream = (VteStream *) g_object_ref (stream);
+        reader->parent.tail = stream->tail;
+        reader->parent.head = stream->head;
+        reader->disk_end = ALIGN_BOA(stream->head);
+        reader->wbuf = (char *) g_memdup (stream->wbuf, MOD_BOA(stream->head));
+        reader->rbuf_offset = 1;  /* Invalidate */
+
+        g_mutex_lock (&stream->readers_lock);
+        stream->readers = g_slist_prepend (stream->readers, reader);
+        g_mutex_unlock (&stream->readers_lock);
+
+        return &reader->parent;
+}
+
+static void
+_vte_file_stream_reader_free (VteStreamReader *areader)
+{
+        VteFileStreamReader *reader = (VteFileStreamReader *) areader;
+	VteFileStream *stream = (VteFileStream *) areader->stream;
+
+        /* The stream releases the blocks once its tail moves on to
+         * another block */
+        g_mutex_lock (&stream->readers_lock);
+        stream->readers = g_slist_remove (stream->readers, reader);
+        g_mutex_unlock (&stream->readers_lock);
+
+        g_free (reader->wbuf);
+        g_free (reader->rbuf);
+        g_free (reader);
+        g_object_unref (stream);
+}
+
+static gboolean
+_vte_file_stream_reader_read (VteStreamReader *areader, gsize offset, char *data, gsize len)
+{
+        VteFileStreamReader *reader = (VteFileStreamReader *) areader;
+	VteFileStream *stream = (VteFileStream *) areader->stream;
+
+        if (G_UNLIKELY (offset < areader->tail || offset + len > areader->head || offset + len < offset))
+                return FALSE;
+
+        while (len && offset < ALIGN_BOA(areader->head)) {
+                gsize l = MIN(VTE_BOA_BLOCKSIZE - MOD_BOA(offset), len);
+                gsize offset_aligned = ALIGN_BOA(offset);
+                if (offset_aligned != reader->rbuf_offset) {
+                        gboolean ok;
+                        if (reader->rbuf == NULL)
+                                reader->rbuf = (char *)g_malloc(VTE_BOA_BLOCKSIZE);
+                        _vte_file_stream_lock (stream);
+                        ok = offset_aligned < reader->disk_end &&
+                             _vte_boa_read (stream->boa, offset_aligned, reader->rbuf);
+                        _vte_file_stream_unlock (stream);
+                        if (G_UNLIKELY (!ok))
+                                return FALSE;
+                        reader->rbuf_offset = offset_aligned;
+                }
+                memcpy(data, reader->rbuf + MOD_BOA(offset), l);
+                offset += l; data += l; len -= l;
+        }
+        if (len)
+                memcpy(data, reader->wbuf + MOD_BOA(offset), len);
+        return TRUE;
+}
+
 static void
 _vte_file_stream_class_init (VteFileStreamClass *klass)
 {
@@ -1240,6 +1551,11 @@ _vte_file_stream_class_init (VteFileStreamClass *klass)
 	klass->advance_tail = _vte_file_stream_advance_tail;
 	klass->tail = _vte_file_stream_tail;
 	klass->head = _vte_file_stream_head;
+	klass->trim = _vte_file_stream_trim;
+	klass->buffer_size = _vte_file_stream_buffer_size;
+	klass->reader_new = _vte_file_stream_reader_new;
+	klass->reader_free = _vte_file_stream_reader_free;
+	klass->reader_read = _vte_file_stream_reader_read;
 }
 
 G_END_DECLS
@@ -1754,14 +2070,194 @@ test_stream (void)
         g_object_unref (astream);
 }
 
+static void
+test_reader (void)
+{
+        char buf[32];
+        VteStream *astream = _vte_file_stream_new();
+        VteFileStream *stream = (VteFileStream *) astream;
+        VteStreamReader *reader;
+
+        stream_append (astream, "axolotl" "beeeeee" "cat");
+        reader = _vte_stream_reader_new (astream);
+        g_assert_cmpuint (_vte_stream_reader_tail (reader), ==, 0);
+        g_assert_cmpuint (_vte_stream_reader_head (reader), ==, 17);
+
+        /* The stream moves on, but keeps the blocks pinned by the reader */
+        stream_append (astream, "dolphin" "echidna");
+        _vte_stream_advance_tail (astream, 21);
+        assert_stream (astream, 21, 31, "hin" "echidna");
+        g_assert_cmpuint (stream->boa->tail, ==, 0);
+
+        /* The reader still sees the contents from when it was created,
+         * including what was only in the write buffer back then */
+        g_assert_true (_vte_stream_reader_read (reader, 0, buf, 17));
+        g_assert (memcmp (buf, "axolotl" "beeeeee" "cat", 17) == 0);
+        g_assert_true (_vte_stream_reader_read (reader, 12, buf, 3));
+        g_assert (memcmp (buf, "eec", 3) == 0);
+        g_assert_false (_vte_stream_reader_read (reader, 10, buf, 10));
+
+        /* Once the reader is gone, the blocks are released when the tail
+         * moves on to another block */
+        _vte_stream_reader_free (reader);
+        _vte_stream_advance_tail (astream, 22);
+        g_assert_cmpuint (stream->boa->tail, ==, 0);
+        _vte_stream_advance_tail (astream, 28);
+        g_assert_cmpuint (stream->boa->tail, ==, 28);
+
+        /* Truncating into the pinned range makes those blocks unreadable */
+        stream_append (astream, "flicker");
+        reader = _vte_stream_reader_new (astream);
+        _vte_stream_truncate (astream, 30);
+        g_assert_false (_vte_stream_reader_read (reader, 28, buf, 2));
+        g_assert_true (_vte_stream_reader_read (reader, 35, buf, 3));
+        g_assert (memcmp (buf, "ker", 3) == 0);
+        _vte_stream_reader_free (reader);
+
+        g_object_unref (astream);
+}
+
+static void
+test_trim (void)
+{
+        VteStream *astream = _vte_file_stream_new();
+        VteFileStream *stream = (VteFileStream *) astream;
+
+        /* Nothing is allocated until it's needed */
+        g_assert_cmpuint (_vte_stream_get_buffer_size (astream), ==, 0);
+        stream_append (astream, "axolotl" "beeeeee" "cat");
+        g_assert_cmpuint (_vte_stream_get_buffer_size (astream), ==, 7);
+        assert_stream (astream, 0, 17, "axolotl" "beeeeee" "cat");
+        g_assert_cmpuint (_vte_stream_get_buffer_size (astream), ==, 14);
+
+        /* Only the partial block is kept, and everything reads back */
+        _vte_stream_trim (astream);
+        g_assert_true (stream->wbuf_compact);
+        g_assert_cmpuint (_vte_stream_get_buffer_size (astream), ==, 3);
+        assert_stream (astream, 0, 17, "axolotl" "beeeeee" "cat");
+        _vte_stream_trim (astream);
+
+        /* Appending continues the partial block */
+        stream_append (astream, "dolphin");
+        g_assert_false (stream->wbuf_compact);
+        assert_stream (astream, 0, 24, "axolotl" "beeeeee" "catdolp" "hin");
+
+        /* Truncating into a stored block reloads it into the write buffer */
+        _vte_stream_trim (astream);
+        _vte_stream_truncate (astream, 9);
+        assert_stream (astream, 0, 9, "axolotl" "be");
+        stream_append (astream, "e");
+        assert_stream (astream, 0, 10, "axolotl" "bee");
+
+        g_object_unref (astream);
+}
+
+static void
+test_gate_set (gboolean closed)
+{
+        g_mutex_lock (&_vte_file_stream_test_gate_lock);
+        _vte_file_stream_test_gate_closed = closed;
+        g_cond_broadcast (&_vte_file_stream_test_gate_cond);
+        g_mutex_unlock (&_vte_file_stream_test_gate_lock);
+}
+
+/* Lets the worker go on a bit later, while the main thread is waiting for it */
+static gpointer
+test_gate_open_later (gpointer data)
+{
+        g_usleep (20000);
+        test_gate_set (FALSE);
+        return NULL;
+}
+
+/* Waits until the block in flight, if any, has been written */
+static void
+test_wait_written (VteFileStream *stream)
+{
+        g_mutex_lock (&stream->lock);
+        while (stream->write_pending)
+                g_cond_wait (&stream->write_cond, &stream->lock);
+        g_mutex_unlock (&stream->lock);
+}
+
+#define test_gate_open_while(__stmt) do { \
+        GThread *__thread = g_thread_new ("gate", test_gate_open_later, NULL); \
+        __stmt; \
+        g_thread_join (__thread); \
+} while (0)
+
+static void
+test_background (void)
+{
+        VteStream *astream = _vte_file_stream_new();
+        VteFileStream *stream = (VteFileStream *) astream;
+
+        _vte_file_stream_write_in_background = TRUE;
+
+        /* A completed block is readable while it's being written */
+        test_gate_set (TRUE);
+        stream_append (astream, "axolotl" "bee");
+        g_assert_true (stream->write_pending);
+        g_assert_cmpuint (stream->pbuf_offset, ==, 0);
+        assert_stream (astream, 0, 10, "axolotl" "bee");
+        g_assert_true (stream->write_pending);
+        g_assert_cmpuint (stream->rbuf_offset, ==, 1);
+
+        /* Completing the next block waits for the previous one */
+        test_gate_open_while (stream_append (astream, "eeee" "cat"));
+        assert_stream (astream, 0, 17, "axolotl" "beeeeee" "cat");
+
+        /* Truncating into the block in flight waits for it to be written.
+         * Let the worker finish the last block first, so that it isn't
+         * held back by the gate too. */
+        test_wait_written (stream);
+        test_gate_set (TRUE);
+        stream_append (astream, "fish");
+        g_assert_true (stream->write_pending);
+        g_assert_cmpuint (stream->pbuf_offset, ==, 14);
+        test_gate_open_while (_vte_stream_truncate (astream, 16));
+        g_assert_false (stream->write_pending);
+        g_assert_cmpuint (stream->pbuf_offset, ==, 1);
+        assert_stream (astream, 0, 16, "axolotl" "beeeeee" "ca");
+
+        /* So does advancing the tail past it */
+        test_gate_set (TRUE);
+        stream_append (astream, "ttle" "dolphin");
+        g_assert_true (stream->write_pending);
+        test_gate_open_while (_vte_stream_advance_tail (astream, 22));
+        g_assert_false (stream->write_pending);
+        g_assert_cmpuint (stream->boa->tail, ==, 21);
+        assert_stream (astream, 22, 27, "lphin");
+
+        /* And resetting */
+        test_gate_set (TRUE);
+        stream_append (astream, "echi");
+        g_assert_true (stream->write_pending);
+        test_gate_open_while (_vte_stream_reset (astream, 35));
+        g_assert_false (stream->write_pending);
+        assert_stream (astream, 35, 35, "");
+        stream_append (astream, "dnaaaaa");
+        assert_stream (astream, 35, 42, "dnaaaaa");
+
+        g_object_unref (astream);
+
+        _vte_file_stream_write_in_background = FALSE;
+}
+
 int
 main (int argc, char **argv)
 {
+        /* The tests check the file contents right after appending */
+        _vte_file_stream_write_in_background = FALSE;
+
         test_fakes();
 
         test_snake();
         test_boa();
         test_stream();
+        test_reader();
+        test_trim();
+        test_background();
 
         printf("vtestream-file tests passed :)\n");
         return 0;
@@ -35,6 +35,21 @@ void _vte_stream_truncate (VteStream *stream, gsize offset);
 void _vte_stream_advance_tail (VteStream *stream, gsize offset);
 gsize _vte_stream_tail (VteStream *stream);
 gsize _vte_stream_head (VteStream *stream);
+void _vte_stream_trim (VteStream *stream);
+gsize _vte_stream_get_buffer_size (VteStream *stream);
+
+/* Readers pin the contents of a stream as it is when they are created.
+ * Unlike the stream itself, a reader can be used from any thread, one at a
+ * time. Reads fail once the stream is reset, or truncated into the pinned
+ * range, so that the data read back is never newer than the pin. */
+
+typedef struct _VteStreamReader VteStreamReader;
+
+VteStreamReader *_vte_stream_reader_new (VteStream *stream);
+void _vte_stream_reader_free (VteStreamReader *reader);
+gboolean _vte_stream_reader_read (VteStreamReader *reader, gsize offset, char *data, gsize len);
+gsize _vte_stream_reader_tail (VteStreamReader *reader);
+gsize _vte_stream_reader_head (VteStreamReader *reader);
 
 /* Various streams */
 